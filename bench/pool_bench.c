@@ -0,0 +1,356 @@
+/*****************************************************
+ *
+ * Description: pool allocator micro-benchmarks, compared
+ *              against system malloc with the same harness
+ *
+ * Usage: pool_bench [ops] > results.csv
+ *
+ ****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "pool_alloc.h"
+
+#if defined(POOL_CONCURRENT) || defined(POOL_LOCKFREE)
+#define BENCH_THREADED
+#endif
+
+#define BENCH_OPS 1000000       // default # of timed operations per workload
+#define BENCH_HEAP (64 << 20)   // bytes of benchmark pool instance
+#define BENCH_BURST 1024        // blocks per LIFO burst
+#define BENCH_LIVE 4096         // live blocks of random and mixed workloads
+#define BENCH_RING 1024         // slots of producer/consumer ring, power of 2
+
+/* allocator under test */
+typedef struct {
+    const char* name;
+    void* (*alloc)(size_t n);
+    void (*free)(void* ptr);
+    bool threaded;              // safe to free from another thread
+} bench_alloc_t;
+
+/* one run of a workload - per-op latency samples are only taken when samples != NULL */
+typedef struct {
+    const bench_alloc_t* a;
+    size_t ops;                 // # of alloc + free operations to run
+    uint32_t* samples;          // latency of each op in ns
+    size_t sample_cnt;
+    uint64_t rng;               // xorshift state
+} bench_t;
+
+/* workload, runs b->ops operations */
+typedef void (*bench_fn_t)(bench_t* b);
+
+static pool_t* g_heap = NULL;
+
+/* cost of timing an empty op, subtracted from latency samples */
+static uint32_t g_timer_ns = 0;
+
+static void* pool_alloc_fn(size_t n) { return pool_malloc_from(g_heap, n); }
+static void pool_free_fn(void* ptr) { pool_free_from(g_heap, ptr); }
+
+static const bench_alloc_t g_allocs[] = {
+#ifdef BENCH_THREADED
+    { "pool_alloc", pool_alloc_fn, pool_free_fn, true },
+#else
+    { "pool_alloc", pool_alloc_fn, pool_free_fn, false },
+#endif
+    { "malloc", malloc, free, true },
+};
+
+/* mixed-size histogram, sizes weighted toward small blocks */
+static const size_t g_mix_sizes[] = { 16, 32, 64, 128, 256, 512, 1024, 2048 };
+static const uint32_t g_mix_weights[] = { 30, 25, 15, 10, 8, 6, 4, 2 };
+#define MIX_CNT (sizeof(g_mix_sizes) / sizeof(g_mix_sizes[0]))
+
+/* Description: monotonic clock
+ * Args: void
+ * Return: time in ns
+ */
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* Description: xorshift64 pseudo random number
+ * Args: b - benchmark run holding generator state
+ * Return: random number
+ */
+static inline uint64_t rnd(bench_t* b) {
+    b->rng ^= b->rng << 13;
+    b->rng ^= b->rng >> 7;
+    b->rng ^= b->rng << 17;
+    return b->rng;
+}
+
+/* time op, recording its latency when sampling */
+#define TIMED(b, op) do { \
+    if ((b)->samples == NULL) { \
+        op; \
+    } \
+    else { \
+        uint64_t t0_ = now_ns(); \
+        op; \
+        uint64_t dt_ = now_ns() - t0_; \
+        (b)->samples[(b)->sample_cnt++] = (dt_ > g_timer_ns) ? (uint32_t)(dt_ - g_timer_ns) : 0; \
+    } \
+} while (0)
+
+/* Description: allocate, touching block so both allocators pay for first access
+ * Args: b - benchmark run
+ *       n - size
+ * Return: block, exits on failure
+ */
+static inline void* bench_alloc(bench_t* b, size_t n) {
+    void* ptr;
+    TIMED(b, ptr = b->a->alloc(n));
+    if (ptr == NULL) {
+        fprintf(stderr, "ERROR: %s out of memory\n", b->a->name);
+        exit(1);
+    }
+    *(volatile uint8_t*)ptr = 0;
+    return ptr;
+}
+
+static inline void bench_free(bench_t* b, void* ptr) {
+    TIMED(b, b->a->free(ptr));
+}
+
+/* steady state - alloc and free same size back to back */
+static void bench_steady(bench_t* b) {
+    for (size_t i = 0; i < b->ops / 2; i++) {
+        bench_free(b, bench_alloc(b, 64));
+    }
+}
+
+/* LIFO bursts - allocate a burst, free it in reverse order */
+static void bench_lifo(bench_t* b) {
+    static void* blks[BENCH_BURST];
+    for (size_t i = 0; i < b->ops / (2 * BENCH_BURST); i++) {
+        for (size_t j = 0; j < BENCH_BURST; j++) {
+            blks[j] = bench_alloc(b, 128);
+        }
+        for (size_t j = BENCH_BURST; j > 0; j--) {
+            bench_free(b, blks[j - 1]);
+        }
+    }
+}
+
+/* random order frees - replace a random live block each iteration */
+static void bench_random(bench_t* b) {
+    static void* blks[BENCH_LIVE];
+    for (size_t j = 0; j < BENCH_LIVE; j++) {
+        blks[j] = b->a->alloc(64);
+    }
+    for (size_t i = 0; i < b->ops / 2; i++) {
+        size_t j = rnd(b) % BENCH_LIVE;
+        bench_free(b, blks[j]);
+        blks[j] = bench_alloc(b, 64);
+    }
+    for (size_t j = 0; j < BENCH_LIVE; j++) {
+        b->a->free(blks[j]);
+    }
+}
+
+/* mixed sizes - replace a random live block with one of a size drawn from histogram */
+static void bench_mixed(bench_t* b) {
+    static void* blks[BENCH_LIVE];
+    uint32_t weight_sum = 0;
+    for (size_t k = 0; k < MIX_CNT; k++) {
+        weight_sum += g_mix_weights[k];
+    }
+
+    for (size_t j = 0; j < BENCH_LIVE; j++) {
+        blks[j] = NULL;
+    }
+    for (size_t i = 0; i < b->ops / 2; i++) {
+        uint32_t w = rnd(b) % weight_sum;
+        size_t k = 0;
+        while (w >= g_mix_weights[k]) {
+            w -= g_mix_weights[k++];
+        }
+
+        size_t j = rnd(b) % BENCH_LIVE;
+        if (blks[j] != NULL) {
+            bench_free(b, blks[j]);
+        }
+        blks[j] = bench_alloc(b, g_mix_sizes[k]);
+    }
+    for (size_t j = 0; j < BENCH_LIVE; j++) {
+        if (blks[j] != NULL) {
+            b->a->free(blks[j]);
+        }
+    }
+}
+
+/* single producer single consumer ring of blocks */
+typedef struct {
+    void* slots[BENCH_RING];
+    size_t head;                // written by producer
+    size_t tail;                // written by consumer
+    size_t cnt;                 // # of blocks consumer frees
+    bench_t* b;                 // consumer run, samples after producer's
+} bench_ring_t;
+
+static void* bench_consumer(void* arg) {
+    bench_ring_t* ring = arg;
+    for (size_t i = 0; i < ring->cnt; i++) {
+        while (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == ring->tail) {
+            sched_yield();
+        }
+        bench_free(ring->b, ring->slots[ring->tail % BENCH_RING]);
+        __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+/* producer/consumer - blocks allocated on this thread are freed on another */
+static void bench_xthread(bench_t* b) {
+    static bench_ring_t ring;
+    bench_t consumer = *b;
+    ring.head = 0;
+    ring.tail = 0;
+    ring.cnt = b->ops / 2;
+    ring.b = &consumer;
+
+    /* consumer samples go after the producer's */
+    if (b->samples != NULL) {
+        consumer.samples = b->samples + ring.cnt;
+        consumer.sample_cnt = 0;
+    }
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, bench_consumer, &ring) != 0) {
+        fprintf(stderr, "ERROR: cannot create consumer thread\n");
+        exit(1);
+    }
+    for (size_t i = 0; i < ring.cnt; i++) {
+        while (ring.head - __atomic_load_n(&ring.tail, __ATOMIC_ACQUIRE) == BENCH_RING) {
+            sched_yield();
+        }
+        ring.slots[ring.head % BENCH_RING] = bench_alloc(b, 64);
+        __atomic_store_n(&ring.head, ring.head + 1, __ATOMIC_RELEASE);
+    }
+    pthread_join(thread, NULL);
+
+    if (b->samples != NULL) {
+        memmove(b->samples + b->sample_cnt, consumer.samples, consumer.sample_cnt * sizeof(uint32_t));
+        b->sample_cnt += consumer.sample_cnt;
+    }
+}
+
+static int cmp_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+/* Description: measure median cost of timing an empty op
+ * Args: samples - buffer of at least 1000 samples
+ * Return: timer overhead in ns
+ */
+static uint32_t timer_calibrate(uint32_t* samples) {
+    for (size_t i = 0; i < 1000; i++) {
+        uint64_t t0 = now_ns();
+        samples[i] = (uint32_t)(now_ns() - t0);
+    }
+    qsort(samples, 1000, sizeof(uint32_t), cmp_u32);
+    return samples[500];
+}
+
+/* Description: run workload on allocator and print CSV row
+ * Args: a - allocator
+ *       name - workload name
+ *       fn - workload
+ *       ops - # of operations
+ *       samples - buffer of at least ops latency samples
+ * Return: void
+ */
+static void bench_run(const bench_alloc_t* a, const char* name, bench_fn_t fn, size_t ops, uint32_t* samples) {
+    /* warm up, then time whole run for throughput, then run again sampling every op for latency */
+    bench_t b = { .a = a, .ops = ops, .rng = 0x9E3779B97F4A7C15ull };
+    fn(&b);
+
+    b.rng = 0x9E3779B97F4A7C15ull;
+    uint64_t t0 = now_ns();
+    fn(&b);
+    uint64_t elapsed = now_ns() - t0;
+
+    b.rng = 0x9E3779B97F4A7C15ull;
+    b.samples = samples;
+    b.sample_cnt = 0;
+    fn(&b);
+
+    qsort(samples, b.sample_cnt, sizeof(uint32_t), cmp_u32);
+    printf("%s,%s,%zu,%.2f,%u,%u,%u\n", a->name, name, b.sample_cnt,
+           (double)elapsed / b.sample_cnt,
+           samples[b.sample_cnt * 50 / 100],
+           samples[b.sample_cnt * 99 / 100],
+           samples[b.sample_cnt * 999 / 1000]);
+}
+
+int main(int argc, char** argv) {
+    size_t ops = (argc > 1) ? strtoul(argv[1], NULL, 10) : BENCH_OPS;
+    if (ops < 2 * BENCH_BURST) {
+        ops = 2 * BENCH_BURST;
+    }
+    if (ops < 1000) {
+        ops = 1000;
+    }
+
+    /* pool instance large enough for every workload's live blocks */
+    size_t len = BENCH_HEAP;
+    void* mem = pool_map(&len, true);
+    if (mem == NULL) {
+        fprintf(stderr, "ERROR: cannot map pool memory\n");
+        return 1;
+    }
+    g_heap = pool_create(mem, len, g_mix_sizes, MIX_CNT);
+    uint32_t* samples = malloc(ops * sizeof(uint32_t));
+    if (g_heap == NULL || samples == NULL) {
+        fprintf(stderr, "ERROR: cannot create pool\n");
+        return 1;
+    }
+
+    static const struct {
+        const char* name;
+        bench_fn_t fn;
+        bool threaded;
+    } workloads[] = {
+        { "steady", bench_steady, false },
+        { "lifo", bench_lifo, false },
+        { "random", bench_random, false },
+        { "xthread", bench_xthread, true },
+        { "mixed", bench_mixed, false },
+    };
+
+    /* note: latencies exclude timer overhead, ns_per_op is from an untimed run */
+    g_timer_ns = timer_calibrate(samples);
+
+    printf("allocator,workload,ops,ns_per_op,p50_ns,p99_ns,p999_ns\n");
+    for (size_t i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++) {
+        for (size_t j = 0; j < sizeof(g_allocs) / sizeof(g_allocs[0]); j++) {
+            /* cross thread frees need a thread safe build */
+            if (workloads[i].threaded && !g_allocs[j].threaded) {
+                continue;
+            }
+            bench_run(&g_allocs[j], workloads[i].name, workloads[i].fn, ops, samples);
+        }
+    }
+
+#ifdef POOL_CONCURRENT
+    pool_thread_flush();
+#endif
+    pool_destroy(g_heap);
+    pool_unmap(mem, len);
+    free(samples);
+    return 0;
+}
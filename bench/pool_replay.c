@@ -0,0 +1,330 @@
+/*****************************************************
+ *
+ * Description: replay a capture stream (see pool_capture)
+ *              against candidate block size configs
+ *
+ * Usage: pool_replay trace.bin [-h heap_bytes] sizes [sizes ...] > results.csv
+ *        sizes - comma separated block sizes of one candidate, e.g. 32,64,256
+ *
+ ****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "pool_alloc.h"
+
+#if !defined(POOL_TRACE) || !defined(POOL_BEST_FIT)
+#error "pool_replay needs POOL_TRACE for the capture format and POOL_BEST_FIT to serve any request size"
+#endif
+
+#define REPLAY_NONE UINT32_MAX  // slot of an op with no block to track
+#define REPLAY_CHUNK 4096       // records read per fread
+
+/* trace op, block handles resolved to dense slots so replay indexes an array */
+typedef struct {
+    uint32_t slot;              // slot of block, REPLAY_NONE for requests that failed at capture
+    uint16_t size;              // requested bytes
+    uint8_t op;                 // POOL_TRACE_ALLOC, POOL_TRACE_FREE or POOL_TRACE_EXHAUSTED
+} replay_op_t;
+
+/* whole trace, loaded once and replayed per candidate */
+typedef struct {
+    replay_op_t* ops;
+    size_t op_cnt;
+    size_t op_max;
+    uint32_t slot_cnt;          // # of slots, max blocks live at once in capture
+} replay_t;
+
+/* open addressing map of live capture handles to slots */
+typedef struct {
+    uint64_t* handles;          // 0 = empty, 1 = deleted
+    uint32_t* slots;
+    size_t cap;                 // power of 2
+    size_t used;                // live + deleted entries
+    size_t live;                // live entries
+} handle_map_t;
+
+#define HANDLE_EMPTY 0
+#define HANDLE_DELETED 1
+
+/* Description: monotonic clock
+ * Args: void
+ * Return: time in ns
+ */
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void* xrealloc(void* ptr, size_t len) {
+    ptr = realloc(ptr, len);
+    if (ptr == NULL) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+    return ptr;
+}
+
+/* Description: find entry of handle, or the empty entry where it would be inserted
+ * Args: map - handle map
+ *       handle - capture block address
+ * Return: entry index
+ */
+static size_t map_find(const handle_map_t* map, uint64_t handle) {
+    size_t i = (handle * 0x9E3779B97F4A7C15ull >> 16) & (map->cap - 1);
+    size_t deleted = SIZE_MAX;
+    while (map->handles[i] != HANDLE_EMPTY && map->handles[i] != handle) {
+        if (map->handles[i] == HANDLE_DELETED && deleted == SIZE_MAX) {
+            deleted = i;
+        }
+        i = (i + 1) & (map->cap - 1);
+    }
+    return (map->handles[i] == HANDLE_EMPTY && deleted != SIZE_MAX) ? deleted : i;
+}
+
+/* Description: resize map to cap entries, dropping deleted entries
+ * Args: map - handle map
+ *       cap - new capacity, power of 2
+ * Return: void
+ */
+static void map_resize(handle_map_t* map, size_t cap) {
+    handle_map_t old = *map;
+    map->handles = calloc(cap, sizeof(uint64_t));
+    map->slots = malloc(cap * sizeof(uint32_t));
+    if (map->handles == NULL || map->slots == NULL) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+    map->cap = cap;
+    map->used = 0;
+    map->live = 0;
+
+    for (size_t i = 0; i < old.cap; i++) {
+        if (old.handles[i] > HANDLE_DELETED) {
+            size_t j = map_find(map, old.handles[i]);
+            map->handles[j] = old.handles[i];
+            map->slots[j] = old.slots[i];
+            map->used++;
+            map->live++;
+        }
+    }
+    free(old.handles);
+    free(old.slots);
+}
+
+static void replay_push(replay_t* r, uint32_t slot, uint32_t size, uint8_t op) {
+    if (r->op_cnt == r->op_max) {
+        r->op_max = (r->op_max == 0) ? REPLAY_CHUNK : 2 * r->op_max;
+        r->ops = xrealloc(r->ops, r->op_max * sizeof(replay_op_t));
+    }
+    r->ops[r->op_cnt++] = (replay_op_t){ .slot = slot, .size = (uint16_t)size, .op = op };
+}
+
+/* Description: load capture stream, pairing each free with its alloc
+ * Args: path - capture file
+ *       r - trace written here
+ * Return: true on success, false if file is not a capture stream
+ */
+static bool replay_load(const char* path, replay_t* r) {
+    FILE* in = fopen(path, "rb");
+    if (in == NULL) {
+        fprintf(stderr, "ERROR: cannot open %s\n", path);
+        return false;
+    }
+
+    pool_capture_hdr_t hdr;
+    if (fread(&hdr, sizeof(hdr), 1, in) != 1 || hdr.magic != POOL_CAPTURE_MAGIC ||
+        hdr.version != POOL_CAPTURE_VERSION || hdr.rec_size != sizeof(pool_capture_rec_t)) {
+        fprintf(stderr, "ERROR: %s is not a capture stream\n", path);
+        fclose(in);
+        return false;
+    }
+
+    handle_map_t map = { 0 };
+    map_resize(&map, 1024);
+    uint32_t* free_slots = NULL;
+    size_t free_cnt = 0;
+    *r = (replay_t){ 0 };
+
+    static pool_capture_rec_t recs[REPLAY_CHUNK];
+    size_t rec_cnt;
+    while ((rec_cnt = fread(recs, sizeof(pool_capture_rec_t), REPLAY_CHUNK, in)) > 0) {
+        for (size_t i = 0; i < rec_cnt; i++) {
+            const pool_capture_rec_t* rec = &recs[i];
+            if (rec->size > MAX_BLOCK_SIZE || rec->handle == HANDLE_DELETED) {
+                continue;
+            }
+
+            if (rec->op == POOL_TRACE_EXHAUSTED) {
+                replay_push(r, REPLAY_NONE, rec->size, POOL_TRACE_EXHAUSTED);
+                continue;
+            }
+
+            size_t j = map_find(&map, rec->handle);
+            bool live = (map.handles[j] == rec->handle);
+
+            /* note: with threads a reused block's alloc can be recorded before its free, free the old one first */
+            if (live) {
+                replay_push(r, map.slots[j], 0, POOL_TRACE_FREE);
+                map.handles[j] = HANDLE_DELETED;
+                map.live--;
+                free_slots = xrealloc(free_slots, (free_cnt + 1) * sizeof(uint32_t));
+                free_slots[free_cnt++] = map.slots[j];
+            }
+
+            if (rec->op == POOL_TRACE_ALLOC) {
+                uint32_t slot = (free_cnt > 0) ? free_slots[--free_cnt] : r->slot_cnt++;
+                replay_push(r, slot, rec->size, POOL_TRACE_ALLOC);
+
+                /* rehash once half full, growing only if live entries are the reason */
+                if (2 * (map.used + 1) > map.cap) {
+                    map_resize(&map, (4 * (map.live + 1) > map.cap) ? 2 * map.cap : map.cap);
+                }
+                j = map_find(&map, rec->handle);
+                map.used += (map.handles[j] == HANDLE_EMPTY);
+                map.live++;
+                map.handles[j] = rec->handle;
+                map.slots[j] = slot;
+            }
+            /* note: frees of blocks allocated before capture started have no alloc to pair with and are dropped */
+        }
+    }
+
+    fclose(in);
+    free(map.handles);
+    free(map.slots);
+    free(free_slots);
+    return true;
+}
+
+/* Description: parse comma separated block sizes
+ * Args: spec - e.g. 32,64,256
+ *       sizes - MAX_POOLS block sizes written here
+ * Return: # of sizes, 0 if invalid
+ */
+static size_t parse_sizes(const char* spec, size_t* sizes) {
+    size_t cnt = 0;
+    const char* p = spec;
+    while (*p != '\0') {
+        char* end;
+        unsigned long sz = strtoul(p, &end, 10);
+        if (end == p || (*end != ',' && *end != '\0') || sz < MIN_BLOCK_SIZE || sz > MAX_BLOCK_SIZE || cnt == MAX_POOLS) {
+            return 0;
+        }
+        sizes[cnt++] = sz;
+        p = (*end == ',') ? end + 1 : end;
+    }
+    return cnt;
+}
+
+/* Description: replay trace on a fresh instance of candidate config and print CSV rows
+ * Args: r - trace
+ *       spec - candidate as given on the command line
+ *       sizes - block sizes
+ *       cnt - # of block sizes
+ *       heap_len - instance bytes
+ * Return: true on success, false if instance cannot be created
+ */
+static bool replay_run(const replay_t* r, const char* spec, const size_t* sizes, size_t cnt, size_t heap_len) {
+    void* mem = aligned_alloc(64, (heap_len + 63) & ~(size_t)63);
+    void** ptrs = calloc((r->slot_cnt > 0) ? r->slot_cnt : 1, sizeof(void*));
+    pool_t* heap = (mem != NULL) ? pool_create(mem, heap_len, sizes, cnt) : NULL;
+    if (heap == NULL || ptrs == NULL) {
+        fprintf(stderr, "ERROR: cannot create instance of %s\n", spec);
+        free(mem);
+        free(ptrs);
+        return false;
+    }
+
+    uint64_t t0 = now_ns();
+    for (size_t i = 0; i < r->op_cnt; i++) {
+        const replay_op_t* op = &r->ops[i];
+        if (op->op == POOL_TRACE_ALLOC) {
+            ptrs[op->slot] = pool_malloc_from(heap, op->size);
+        }
+        else if (op->op == POOL_TRACE_FREE) {
+            if (ptrs[op->slot] != NULL) {
+                pool_free_from(heap, ptrs[op->slot]);
+                ptrs[op->slot] = NULL;
+            }
+        }
+        else {
+            /* request failed at capture, so the application never freed it, return a served block at once */
+            void* ptr = pool_malloc_from(heap, op->size);
+            if (ptr != NULL) {
+                pool_free_from(heap, ptr);
+            }
+        }
+    }
+    uint64_t elapsed = now_ns() - t0;
+
+    /* per pool rows, then a total row with throughput */
+    pool_info_t info;
+    pool_stats_t stats;
+    pool_frag_t frag;
+    uint64_t failures = 0;
+    uint64_t waste = 0;
+    uint64_t idle = 0;
+    for (uint8_t i = 0; i < cnt; i++) {
+        pool_get_info_from(heap, i, &info);
+        pool_get_stats_from(heap, i, &stats);
+        pool_get_frag_from(heap, i, &frag);
+        uint64_t pool_idle = (info.blk_cnt - stats.high_water) * info.blk_sz;
+        printf("\"%s\",%u,%zu,%zu,%lu,%lu,%lu,%lu,%lu,\n", spec, i, info.blk_sz, info.blk_cnt,
+               (unsigned long)stats.allocs, (unsigned long)stats.high_water, (unsigned long)stats.failures,
+               (unsigned long)frag.waste_bytes, (unsigned long)pool_idle);
+        failures += stats.failures;
+        waste += frag.waste_bytes;
+        idle += pool_idle;
+    }
+    printf("\"%s\",all,,,%zu,,%lu,%lu,%lu,%.2f\n", spec, r->op_cnt, (unsigned long)failures,
+           (unsigned long)waste, (unsigned long)idle, (r->op_cnt > 0) ? (double)elapsed / r->op_cnt : 0.0);
+
+    pool_destroy(heap);
+    free(mem);
+    free(ptrs);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s trace.bin [-h heap_bytes] sizes [sizes ...]\n", argv[0]);
+        return 1;
+    }
+
+    replay_t r;
+    if (!replay_load(argv[1], &r)) {
+        return 1;
+    }
+
+    /* default heap matches the instance pool_init creates */
+    size_t heap_len = POOL_HEAP_SIZE;
+    int arg = 2;
+    if (strcmp(argv[arg], "-h") == 0 && argc > arg + 2) {
+        heap_len = strtoul(argv[arg + 1], NULL, 10);
+        arg += 2;
+    }
+
+    printf("candidate,pool,blk_sz,blk_cnt,allocs,peak,failures,waste_bytes,idle_bytes,ns_per_op\n");
+    int ret = 0;
+    for (; arg < argc; arg++) {
+        size_t sizes[MAX_POOLS];
+        size_t cnt = parse_sizes(argv[arg], sizes);
+        if (cnt == 0) {
+            fprintf(stderr, "ERROR: invalid block sizes %s\n", argv[arg]);
+            ret = 1;
+            continue;
+        }
+        if (!replay_run(&r, argv[arg], sizes, cnt, heap_len)) {
+            ret = 1;
+        }
+    }
+
+    free(r.ops);
+    return ret;
+}
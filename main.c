@@ -5,6 +5,182 @@
 
 #include "pool_alloc.h"
 
+/* tail canary bytes after each free list block */
+#ifdef POOL_CANARY
+#define CANARY_SIZE sizeof(uint64_t)
+#else
+#define CANARY_SIZE 0
+#endif
+
+/* link header ahead of each payload */
+#ifdef POOL_HEADERLESS
+#define HDR_SIZE 0
+#else
+#define HDR_SIZE sizeof(uint8_t*)
+#endif
+
+#ifdef POOL_TRACE
+/* trace hook recording event counts and last event */
+typedef struct {
+    size_t cnts[3];
+    uint8_t pool;
+    void* ptr;
+    size_t n;
+} trace_log_t;
+
+static void trace_test(void* ctx, uint8_t event, uint8_t pool, void* ptr, size_t n) {
+    trace_log_t* log = ctx;
+    log->cnts[event]++;
+    log->pool = pool;
+    log->ptr = ptr;
+    log->n = n;
+}
+#endif
+
+#if defined(POOL_CONCURRENT) || defined(POOL_LOCKFREE)
+#include <pthread.h>
+#include <sched.h>
+
+#define THREAD_CNT 4
+#define THREAD_ITRS 10000
+#define THREAD_BLKS 64
+
+/* count free blocks of size n by allocating until exhausted, then free them again */
+static uint16_t count_free_blks(size_t n) {
+    static void* blks[2048];
+    uint16_t cnt = 0;
+    while (cnt < 2048 && (blks[cnt] = pool_malloc(n)) != NULL) {
+        cnt++;
+    }
+    for (uint16_t i = 0; i < cnt; i++) {
+        pool_free(blks[i]);
+    }
+    return cnt;
+}
+
+/* each thread allocates and frees 32 byte blocks, tagging them to detect blocks handed out twice */
+static void* thread_test(void* arg) {
+    uint8_t id = (uint8_t)(uintptr_t)arg;
+    uint8_t* blks[THREAD_BLKS] = { NULL };
+    for (uint32_t i = 0; i < THREAD_ITRS; i++) {
+        uint8_t slot = (i * 7 + id) % THREAD_BLKS;
+        if (blks[slot] != NULL) {
+            assert(blks[slot][0] == id && blks[slot][31] == id);
+            pool_free(blks[slot]);
+            blks[slot] = NULL;
+        }
+        else {
+            blks[slot] = pool_malloc(32);
+            if (blks[slot] != NULL) {
+                blks[slot][0] = id;
+                blks[slot][31] = id;
+            }
+        }
+    }
+    for (uint8_t i = 0; i < THREAD_BLKS; i++) {
+        pool_free(blks[i]);
+    }
+    return NULL;
+}
+
+/* each thread allocates and frees 32 byte blocks in batches, tagging them to detect blocks handed out twice */
+static void* thread_batch_test(void* arg) {
+    uint8_t id = (uint8_t)(uintptr_t)arg;
+    void* blks[THREAD_BLKS / 4];
+    for (uint32_t i = 0; i < THREAD_ITRS / 10; i++) {
+        size_t cnt = pool_malloc_batch(32, blks, 1 + (i + id) % (THREAD_BLKS / 4));
+        for (size_t j = 0; j < cnt; j++) {
+            ((uint8_t*)blks[j])[0] = id;
+            ((uint8_t*)blks[j])[31] = id;
+        }
+        for (size_t j = 0; j < cnt; j++) {
+            assert(((uint8_t*)blks[j])[0] == id && ((uint8_t*)blks[j])[31] == id);
+        }
+        pool_free_batch(blks, cnt);
+    }
+    return NULL;
+}
+
+/* blocks handed from producing to consuming thread */
+typedef struct {
+    void* slots[THREAD_BLKS];
+    size_t head;               // written by producer
+    size_t tail;               // written by consumer
+    size_t cnt;                // # of blocks consumer frees
+} thread_ring_t;
+
+/* consumer frees every block the producer allocated, checking the producer's tag */
+static void* thread_consumer_test(void* arg) {
+    thread_ring_t* ring = arg;
+    for (size_t i = 0; i < ring->cnt; i++) {
+        while (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == ring->tail) {
+            sched_yield();
+        }
+        uint8_t* blk = ring->slots[ring->tail % THREAD_BLKS];
+        assert(blk[0] == (uint8_t)i && blk[31] == (uint8_t)i);
+        pool_free(blk);
+        __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+#ifdef POOL_CONCURRENT
+/* blocks of an instance freed by thread_remote_test */
+static pool_t* g_remote_heap;
+static void** g_remote_blks;
+static size_t g_remote_cnt;
+
+/* frees blocks allocated on another thread singly and exits, returning its magazine */
+static void* thread_remote_test(void* arg) {
+    (void)arg;
+    for (size_t i = 0; i < g_remote_cnt; i++) {
+        pool_free_from(g_remote_heap, g_remote_blks[i]);
+    }
+    return NULL;
+}
+#endif
+
+/* bitmap pool instance shared by thread_bmp_test threads */
+static pool_t* g_bmp_heap;
+
+/* each thread allocates and frees 2 byte bitmap pool blocks singly and in batches, tagging them to detect blocks handed out twice */
+static void* thread_bmp_test(void* arg) {
+    uint8_t id = (uint8_t)(uintptr_t)arg;
+    uint8_t* blks[THREAD_BLKS] = { NULL };
+    for (uint32_t i = 0; i < THREAD_ITRS; i++) {
+        uint8_t slot = (i * 7 + id) % THREAD_BLKS;
+        if (blks[slot] != NULL) {
+            assert(blks[slot][0] == id && blks[slot][1] == id);
+            pool_free_from(g_bmp_heap, blks[slot]);
+            blks[slot] = NULL;
+        }
+        else if (i % 16 == 0) {
+            void* batch[THREAD_BLKS / 4];
+            size_t cnt = pool_malloc_batch_from(g_bmp_heap, 2, batch, THREAD_BLKS / 4);
+            for (size_t j = 0; j < cnt; j++) {
+                ((uint8_t*)batch[j])[0] = id;
+                ((uint8_t*)batch[j])[1] = id;
+            }
+            for (size_t j = 0; j < cnt; j++) {
+                assert(((uint8_t*)batch[j])[0] == id && ((uint8_t*)batch[j])[1] == id);
+            }
+            pool_free_batch_from(g_bmp_heap, batch, cnt);
+        }
+        else {
+            blks[slot] = pool_malloc_from(g_bmp_heap, 2);
+            if (blks[slot] != NULL) {
+                blks[slot][0] = id;
+                blks[slot][1] = id;
+            }
+        }
+    }
+    for (uint8_t i = 0; i < THREAD_BLKS; i++) {
+        pool_free_from(g_bmp_heap, blks[i]);
+    }
+    return NULL;
+}
+#endif
+
 int main() {
     /********************************/
     /******* pool_init() test *******/
@@ -72,7 +248,14 @@ int main() {
         bool result = false;
         size_t block_sizes[] = { 32, 128, 400, 512, 2048 };
         size_t block_size_count = 5;
+#ifdef POOL_NUMA
+        /* two nodes simulated on any box, this thread on node 0 */
+        pool_cfg_t cfg = { .block_sizes = block_sizes, .block_size_count = block_size_count };
+        pool_numa_set_node(0);
+        result = pool_init_numa(&cfg, 2);
+#else
         result = pool_init(block_sizes, block_size_count);
+#endif
         assert(result == true);
     }
 
@@ -105,10 +288,12 @@ int main() {
         assert(result_ptr == NULL);
     }
 
-    {   // too large 
+#ifndef POOL_BEST_FIT
+    {   // not a block size 
         void* result_ptr = pool_malloc(33);
         assert(result_ptr == NULL);
     }
+#endif
 
     /* declare 7 blk pointers to test 6 size 2048 blocks */
     void* blk0 = NULL;
@@ -169,6 +354,14 @@ int main() {
         pool_free((void*)blk0 - 2);
     }
 
+    {   // aligned but in unused bytes after last block of pool (blocks init in address order)
+#ifdef POOL_HEADERLESS
+        pool_free((void*)blk5 + 2048);
+#else
+        pool_free((void*)blk5 + 2048 + sizeof(uint8_t*));
+#endif
+    }
+
     /* test valid free - prove no free blocks, then free one, then retest malloc */
     {
         /* make sure no free block to allocate */
@@ -183,12 +376,1213 @@ int main() {
         assert(blk6 != NULL);
     }
 
+    /* test free resolves correct pool - freed block must be reused by next malloc of same size */
+    {
+        size_t sizes[] = { 32, 128, 400, 512 };
+        for (uint8_t i = 0; i < 4; i++) {
+            void* blk_a = pool_malloc(sizes[i]);
+            assert(blk_a != NULL);
+            pool_free(blk_a);
+            void* blk_b = pool_malloc(sizes[i]);
+            assert(blk_b == blk_a);
+            pool_free(blk_b);
+        }
+    }
+
+#ifdef POOL_BEST_FIT
+    /* test best fit - size between block sizes served by next larger pool */
+    {
+        pool_frag_t frag_before, frag_after;
+        assert(pool_get_frag(1, &frag_before));
+        void* blk = pool_malloc(33);
+        assert(blk != NULL);
+        assert(pool_get_frag(1, &frag_after));
+        assert(frag_after.allocs == frag_before.allocs + 1);
+        assert(frag_after.waste_bytes == frag_before.waste_bytes + (128 - 33));
+        pool_free(blk);
+    }
+
+    /* test best fit fallback - exhaust 400 pool, expect next allocation served by 512 pool */
+    {
+        void* blks[64];
+        uint8_t blk_cnt = 0;
+        pool_frag_t frag;
+        do {
+            blks[blk_cnt] = pool_malloc(400);
+            assert(blks[blk_cnt] != NULL);
+            assert(pool_get_frag(3, &frag));
+            blk_cnt++;
+        } while (frag.fallbacks == 0 && blk_cnt < 64);
+        assert(frag.fallbacks == 1);
+
+        while (blk_cnt > 0) {
+            pool_free(blks[--blk_cnt]);
+        }
+    }
+#endif
+
     /* test free on already freed block - enable VERBOSE to verify */
     {
         pool_free(blk6);
         pool_free(blk6);
     }
 
+    /* verify rejected frees did not corrupt free list - expect exactly 1 free block */
+    {
+        blk6 = pool_malloc(2048);
+        assert(blk6 != NULL);
+        assert(pool_malloc(2048) == NULL);
+        pool_free(blk6);
+    }
+
+    /**********************************/
+    /******* pool_create() test *******/
+    /**********************************/
+#ifdef VERBOSE
+    printf("\n------- pool_create() test -------\n");
+#endif
+
+    /* test invalid instance memory */
+    {
+        static uint8_t mem[256];
+        size_t block_sizes[] = { 32 };
+        assert(pool_create(NULL, sizeof(mem), block_sizes, 1) == NULL);
+        assert(pool_create(mem, 16, block_sizes, 1) == NULL);
+    }
+
+    /* test heap too small to hold one block of each pool */
+    {
+        static uint8_t mem[4096];
+        size_t block_sizes[] = { 32, MAX_BLOCK_SIZE };
+        assert(pool_create(mem, sizeof(mem), block_sizes, 2) == NULL);
+    }
+
+    /* test independent instances - blocks do not cross, destroy invalidates instance */
+    {
+        static uint8_t mem_a[8192];
+        static uint8_t mem_b[16384];
+        size_t block_sizes_a[] = { 16, 64 };
+        size_t block_sizes_b[] = { 64, 256 };
+        pool_t* heap_a = pool_create(mem_a, sizeof(mem_a), block_sizes_a, 2);
+        pool_t* heap_b = pool_create(mem_b, sizeof(mem_b), block_sizes_b, 2);
+        assert(heap_a != NULL && heap_b != NULL);
+
+        /* sizes served only by the instance configured for them */
+#ifndef POOL_BEST_FIT
+        assert(pool_malloc_from(heap_b, 16) == NULL);
+#endif
+        uint8_t* blk_a = pool_malloc_from(heap_a, 64);
+        uint8_t* blk_b = pool_malloc_from(heap_b, 64);
+        assert(blk_a >= mem_a && blk_a < mem_a + sizeof(mem_a));
+        assert(blk_b >= mem_b && blk_b < mem_b + sizeof(mem_b));
+
+        /* freeing to wrong instance rejected - enable VERBOSE to verify */
+        pool_free_from(heap_b, blk_a);
+        pool_free_from(heap_a, blk_a);
+        assert(pool_malloc_from(heap_a, 64) == blk_a);
+
+        /* destroyed instance rejects use, memory reusable for new instance */
+#ifdef POOL_CONCURRENT
+        pool_thread_flush();
+#endif
+        pool_destroy(heap_a);
+        assert(pool_malloc_from(heap_a, 64) == NULL);
+        heap_a = pool_create(mem_a, sizeof(mem_a), block_sizes_b, 2);
+        assert(heap_a != NULL);
+        assert(pool_malloc_from(heap_a, 256) != NULL);
+#ifdef POOL_CONCURRENT
+        pool_thread_flush();
+#endif
+        pool_destroy(heap_a);
+        pool_destroy(heap_b);
+    }
+
+    /* test weighted and explicit pool sizing */
+    {
+        static uint8_t mem[32768];
+        size_t block_sizes[] = { 32, 128, 2048 };
+        uint32_t weights[] = { 3, 1, 0 };
+        size_t block_counts[] = { 0, 0, 4 };
+        pool_cfg_t cfg = { block_sizes, 3, weights, block_counts };
+        pool_t* heap = pool_create_cfg(mem, sizeof(mem), &cfg);
+        assert(heap != NULL);
+
+        pool_info_t info[3];
+        for (uint8_t i = 0; i < 3; i++) {
+            assert(pool_get_info_from(heap, i, &info[i]));
+            assert(info[i].blk_sz == block_sizes[i]);
+            assert(info[i].slack_bytes < block_sizes[i] + sizeof(uint8_t*) + CANARY_SIZE);
+        }
+
+        /* explicit count pool has exactly 4 blocks, weighted pools split rest 3:1 (within rounding, plus link alignment) */
+        assert(info[2].blk_cnt == 4 && info[2].slack_bytes == 0);
+        size_t split_err = 3 * sizeof(uint8_t*);
+        assert(info[0].pool_bytes + split_err >= 3 * info[1].pool_bytes && info[0].pool_bytes <= 3 * info[1].pool_bytes + split_err);
+
+        for (uint8_t i = 0; i < 4; i++) {
+            assert(pool_malloc_from(heap, 2048) != NULL);
+        }
+        assert(pool_malloc_from(heap, 2048) == NULL);
+#ifdef POOL_CONCURRENT
+        pool_thread_flush();
+#endif
+        pool_destroy(heap);
+
+        /* block counts that do not fit */
+        block_counts[2] = 100;
+        assert(pool_create_cfg(mem, sizeof(mem), &cfg) == NULL);
+
+        /* pool with neither block count nor weight */
+        block_counts[2] = 0;
+        assert(pool_create_cfg(mem, sizeof(mem), &cfg) == NULL);
+    }
+
+    /* test per-pool alignment - every block data aligned, aligned malloc picks a pool that guarantees it */
+    {
+        static uint8_t mem[65536];
+        size_t block_sizes[] = { 64, 400, 64, 2048 };
+        size_t alignments[] = { 0, 64, 64, 4096 };
+        pool_cfg_t cfg = { .block_sizes = block_sizes, .block_size_count = 4, .alignments = alignments };
+        pool_t* heap = pool_create_cfg(mem, sizeof(mem), &cfg);
+        assert(heap != NULL);
+
+        pool_info_t info;
+        assert(pool_get_info_from(heap, 3, &info));
+        assert(info.blk_align == 4096 && info.blk_cnt >= 2);
+
+        /* allocate every block of aligned pools, then free them again */
+        static void* blks[64];
+        size_t sizes[] = { 400, 2048 };
+        size_t aligns[] = { 64, 4096 };
+        for (uint8_t i = 0; i < 2; i++) {
+            size_t blk_cnt = 0;
+            while ((blks[blk_cnt] = pool_malloc_from(heap, sizes[i])) != NULL) {
+                assert((uintptr_t)blks[blk_cnt] % aligns[i] == 0);
+                blk_cnt++;
+            }
+            assert(blk_cnt > 0);
+            for (size_t j = 0; j < blk_cnt; j++) {
+                pool_free_from(heap, blks[j]);
+            }
+        }
+
+        /* size table maps 64 to first pool, aligned malloc uses second */
+        uint8_t* blk = pool_malloc_aligned_from(heap, 64, 64);
+        assert(blk != NULL && (uintptr_t)blk % 64 == 0);
+        pool_free_from(heap, blk);
+
+        /* no pool guarantees alignment */
+#ifndef POOL_BEST_FIT
+        assert(pool_malloc_aligned_from(heap, 400, 128) == NULL);
+#endif
+        assert(pool_malloc_aligned_from(heap, 64, 3) == NULL);
+#ifdef POOL_CONCURRENT
+        pool_thread_flush();
+#endif
+        pool_destroy(heap);
+
+        /* invalid alignments */
+        alignments[0] = 24;
+        assert(pool_create_cfg(mem, sizeof(mem), &cfg) == NULL);
+        alignments[0] = 2 * MAX_BLOCK_ALIGN;
+        assert(pool_create_cfg(mem, sizeof(mem), &cfg) == NULL);
+    }
+
+    /* test batch malloc and free - whole pool in one call, mixed pools and invalid ptrs on free */
+    {
+        static uint8_t mem[8192];
+        static void* blks[256];
+        size_t block_sizes[] = { 32, 128 };
+        pool_t* heap = pool_create(mem, sizeof(mem), block_sizes, 2);
+        assert(heap != NULL);
+
+        pool_info_t info;
+        assert(pool_get_info_from(heap, 0, &info));
+        assert(info.blk_cnt < 256);
+
+        /* empty batch takes no block */
+        pool_stats_t stats;
+        assert(pool_malloc_batch_from(heap, 32, blks, 0) == 0);
+        assert(pool_get_stats_from(heap, 0, &stats) && stats.in_use == 0);
+
+        /* ask for more than pool holds, get every block once (plus one from next pool with best fit) */
+        size_t blk_cnt = pool_malloc_batch_from(heap, 32, blks, info.blk_cnt + 1);
+#ifdef POOL_BEST_FIT
+        assert(blk_cnt == info.blk_cnt + 1);
+#else
+        assert(blk_cnt == info.blk_cnt);
+#endif
+        for (size_t i = 0; i < blk_cnt; i++) {
+            assert(blks[i] != NULL);
+            ((uint8_t*)blks[i])[0] = (uint8_t)i;
+        }
+        for (size_t i = 0; i < blk_cnt; i++) {
+            assert(((uint8_t*)blks[i])[0] == (uint8_t)i);
+        }
+#ifndef POOL_BEST_FIT
+        assert(pool_malloc_from(heap, 32) == NULL);
+#endif
+
+        /* mixed pools, NULL and a double free skipped - enable VERBOSE to verify */
+        blks[blk_cnt] = pool_malloc_from(heap, 128);
+        blks[blk_cnt + 1] = NULL;
+        blks[blk_cnt + 2] = blks[0];
+        assert(blks[blk_cnt] != NULL);
+        pool_free_batch_from(heap, blks, blk_cnt + 3);
+
+        assert(pool_malloc_batch_from(heap, 32, blks, info.blk_cnt) == info.blk_cnt);
+        pool_free_batch_from(heap, blks, info.blk_cnt);
+#ifndef POOL_BEST_FIT
+        assert(pool_malloc_batch_from(heap, 33, blks, 1) == 0);
+#endif
+#ifdef POOL_CONCURRENT
+        pool_thread_flush();
+#endif
+        pool_destroy(heap);
+    }
+
+    /* test lazy init - blocks untouched until first handed out, then handed out in address order */
+    {
+        static uint8_t mem[8192];
+        for (size_t i = 0; i < sizeof(mem); i++) {
+            mem[i] = 0x5A;
+        }
+        size_t block_sizes[] = { 64 };
+        pool_t* heap = pool_create(mem, sizeof(mem), block_sizes, 1);
+        assert(heap != NULL);
+        pool_info_t info;
+        assert(pool_get_info_from(heap, 0, &info));
+
+        uint8_t* prev = pool_malloc_from(heap, 64);
+        assert(prev != NULL);
+#if !defined(POOL_CONCURRENT) && !defined(POOL_POISON) && !defined(__SANITIZE_ADDRESS__)
+        for (uint8_t* byte = prev + 64 + CANARY_SIZE; byte < mem + sizeof(mem); byte++) {
+            assert(*byte == 0x5A);
+        }
+#endif
+        for (size_t i = 1; i < info.blk_cnt; i++) {
+            uint8_t* blk = pool_malloc_from(heap, 64);
+            assert(blk != NULL);
+#ifndef POOL_CONCURRENT
+            assert(blk == prev + 64 + HDR_SIZE + CANARY_SIZE);
+#endif
+            prev = blk;
+        }
+        assert(pool_malloc_from(heap, 64) == NULL);
+#ifdef POOL_CONCURRENT
+        pool_thread_flush();
+#endif
+        pool_destroy(heap);
+    }
+
+    /* test bitmap pools - blocks packed without header, lowest free block first, batches claim whole words */
+    {
+        static uint8_t mem[16384];
+        static void* blks[4096];
+        size_t block_sizes[] = { 4, 64 };
+        bool bitmaps[] = { true, false };
+        pool_cfg_t cfg = { .block_sizes = block_sizes, .block_size_count = 2, .bitmaps = bitmaps };
+        pool_t* heap = pool_create_cfg(mem, sizeof(mem), &cfg);
+        assert(heap != NULL);
+
+        pool_info_t info;
+        assert(pool_get_info_from(heap, 1, &info));
+        assert(!info.bitmap);
+        assert(pool_get_info_from(heap, 0, &info));
+        assert(info.bitmap && info.blk_align == 1 && info.blk_cnt == info.pool_bytes / 4);
+        assert(info.blk_cnt <= 4096);
+
+        /* exhaust in address order, blocks back to back */
+        for (size_t i = 0; i < info.blk_cnt; i++) {
+            blks[i] = pool_malloc_from(heap, 4);
+            assert(blks[i] != NULL && pool_owns_from(heap, blks[i]));
+            assert(i == 0 || (uint8_t*)blks[i] == (uint8_t*)blks[i - 1] + 4);
+            *(uint32_t*)blks[i] = (uint32_t)i;
+        }
+#ifndef POOL_BEST_FIT
+        assert(pool_malloc_from(heap, 4) == NULL);
+#endif
+        for (size_t i = 0; i < info.blk_cnt; i++) {
+            assert(*(uint32_t*)blks[i] == (uint32_t)i);
+        }
+
+        /* double free and unaligned ptr rejected - enable VERBOSE to verify */
+        pool_free_from(heap, blks[100]);
+        pool_free_from(heap, blks[100]);
+        pool_free_from(heap, (uint8_t*)blks[200] + 1);
+        pool_free_from(heap, blks[5]);
+        assert(pool_malloc_from(heap, 4) == blks[5]);
+        assert(pool_malloc_from(heap, 4) == blks[100]);
+
+        /* batch claims lowest free blocks across words, batch free mixes pools */
+        pool_free_batch_from(heap, &blks[10], 190);
+        void* out[190];
+        assert(pool_malloc_batch_from(heap, 4, out, 190) == 190);
+        for (size_t i = 0; i < 190; i++) {
+            assert(out[i] == blks[10 + i]);
+        }
+        blks[info.blk_cnt] = pool_malloc_from(heap, 64);
+        assert(blks[info.blk_cnt] != NULL);
+        pool_free_batch_from(heap, blks, info.blk_cnt + 1);
+
+        pool_stats_t stats;
+        assert(pool_get_stats_from(heap, 0, &stats));
+        assert(stats.in_use == 0 && stats.free_blks == info.blk_cnt);
+        assert(pool_malloc_batch_from(heap, 4, blks, info.blk_cnt) == info.blk_cnt);
+        pool_free_batch_from(heap, blks, info.blk_cnt);
+#ifdef POOL_CONCURRENT
+        pool_thread_flush();
+#endif
+        pool_destroy(heap);
+
+#ifdef __unix__
+        /* bitmap pools cannot grow */
+        cfg.slab_alloc = pool_slab_map;
+        assert(pool_create_cfg(mem, sizeof(mem), &cfg) == NULL);
+#endif
+    }
+
+    /* test large bitmap pool - summary bitmap skips full words, a free block near the end is still found */
+    {
+        static uint8_t mem[1 << 20];
+        size_t block_sizes[] = { 1 };
+        bool bitmaps[] = { true };
+        pool_cfg_t cfg = { .block_sizes = block_sizes, .block_size_count = 1, .bitmaps = bitmaps };
+        pool_t* heap = pool_create_cfg(mem, sizeof(mem), &cfg);
+        assert(heap != NULL);
+
+        pool_info_t info;
+        assert(pool_get_info_from(heap, 0, &info));
+        assert(info.blk_cnt > (1 << 19));
+
+        static void* blks[4096];
+        uint8_t* first = NULL;
+        size_t blk_cnt = 0;
+        size_t got;
+        while ((got = pool_malloc_batch_from(heap, 1, blks, 4096)) > 0) {
+            first = (first == NULL) ? (uint8_t*)blks[0] : first;
+            assert((uint8_t*)blks[0] == first + blk_cnt && (uint8_t*)blks[got - 1] == first + blk_cnt + got - 1);
+            blk_cnt += got;
+        }
+        assert(blk_cnt == info.blk_cnt);
+
+        pool_free_from(heap, first + blk_cnt - 3);
+        pool_free_from(heap, first + blk_cnt / 2);
+        assert(pool_malloc_from(heap, 1) == first + blk_cnt / 2);
+        assert(pool_malloc_from(heap, 1) == first + blk_cnt - 3);
+        assert(pool_malloc_from(heap, 1) == NULL);
+        for (size_t i = 0; i < blk_cnt; i++) {
+            pool_free_from(heap, first + i);
+        }
+        assert(pool_malloc_from(heap, 1) == first);
+#ifdef POOL_CONCURRENT
+        pool_thread_flush();
+#endif
+        pool_destroy(heap);
+    }
+
+    /* test usage counters - allocs, frees, exhaustion and high water mark */
+    {
+        static uint8_t mem[8192];
+        static void* blks[64];
+        size_t block_sizes[] = { 32, 128 };
+        pool_t* heap = pool_create(mem, sizeof(mem), block_sizes, 2);
+        assert(heap != NULL);
+
+        pool_info_t info;
+        pool_stats_t stats;
+        assert(pool_get_info_from(heap, 1, &info));
+        assert(info.blk_cnt < 64);
+        assert(pool_get_stats_from(heap, 1, &stats));
+        assert(stats.allocs == 0 && stats.frees == 0 && stats.failures == 0);
+        assert(stats.in_use == 0 && stats.high_water == 0 && stats.free_blks == info.blk_cnt);
+
+        /* exhaust largest pool, fail once, free half and invalid ptr not counted */
+        for (size_t i = 0; i < info.blk_cnt; i++) {
+            blks[i] = pool_malloc_from(heap, 128);
+            assert(blks[i] != NULL);
+        }
+        assert(pool_malloc_from(heap, 128) == NULL);
+        assert(pool_malloc_from(heap, 129) == NULL);
+        for (size_t i = 0; i < info.blk_cnt / 2; i++) {
+            pool_free_from(heap, blks[i]);
+        }
+        pool_free_from(heap, blks[0]);
+
+        assert(pool_get_stats_from(heap, 1, &stats));
+        assert(stats.allocs == info.blk_cnt && stats.frees == info.blk_cnt / 2 && stats.failures == 1);
+        assert(stats.in_use == info.blk_cnt - info.blk_cnt / 2);
+        assert(stats.high_water == info.blk_cnt);
+        assert(stats.free_blks == info.blk_cnt / 2);
+
+        /* other pool untouched, invalid pool and args rejected */
+        assert(pool_get_stats_from(heap, 0, &stats));
+        assert(stats.allocs == 0 && stats.failures == 0 && stats.high_water == 0);
+        assert(!pool_get_stats_from(heap, 2, &stats));
+        assert(!pool_get_stats_from(heap, 0, NULL));
+        assert(!pool_get_stats_from(NULL, 0, &stats));
+
+        for (size_t i = info.blk_cnt / 2; i < info.blk_cnt; i++) {
+            pool_free_from(heap, blks[i]);
+        }
+        assert(pool_get_stats_from(heap, 1, &stats));
+        assert(stats.in_use == 0 && stats.high_water == info.blk_cnt && stats.free_blks == info.blk_cnt);
+#ifdef POOL_CONCURRENT
+        pool_thread_flush();
+#endif
+        pool_destroy(heap);
+    }
+
+#ifdef POOL_LOCALITY
+    /* test page free lists - after scattered frees, lowest page refills first, most recently freed first within page */
+    {
+        static _Alignas(POOL_PAGE_SIZE) uint8_t mem[8 * POOL_PAGE_SIZE];
+        static uint8_t* blks[8 * POOL_PAGE_SIZE / 64];
+        size_t block_sizes[] = { 64 };
+        pool_t* heap = pool_create(mem, sizeof(mem), block_sizes, 1);
+        assert(heap != NULL);
+
+        /* fresh pool hands out blocks in address order */
+        size_t blk_cnt = 0;
+        while ((blks[blk_cnt] = pool_malloc_from(heap, 64)) != NULL) {
+            assert(blk_cnt == 0 || blks[blk_cnt] > blks[blk_cnt - 1]);
+            blk_cnt++;
+        }
+        assert(blk_cnt > 2 * POOL_PAGE_SIZE / 64);
+
+        /* free every other block, highest address first */
+        size_t freed = 0;
+        for (size_t i = blk_cnt; i > 0; i--) {
+            if (i % 2 == 0) {
+                pool_free_from(heap, blks[i - 1]);
+                freed++;
+            }
+        }
+
+        /* refill never goes back to a lower page */
+        uintptr_t page = 0;
+        for (size_t i = 0; i < freed; i++) {
+            uint8_t* blk = pool_malloc_from(heap, 64);
+            assert(blk != NULL && (uintptr_t)blk / POOL_PAGE_SIZE >= page);
+            page = (uintptr_t)blk / POOL_PAGE_SIZE;
+        }
+        assert(pool_malloc_from(heap, 64) == NULL);
+
+        /* block of lower page wins over later freed block of higher page */
+        uint8_t* low = blks[0];
+        uint8_t* high = blks[blk_cnt - 1];
+        pool_free_from(heap, low);
+        pool_free_from(heap, high);
+        assert(pool_malloc_from(heap, 64) == low);
+        assert(pool_malloc_from(heap, 64) == high);
+
+        /* same page, last freed first */
+        pool_free_from(heap, blks[0]);
+        pool_free_from(heap, blks[1]);
+        assert(pool_malloc_from(heap, 64) == blks[1]);
+        assert(pool_malloc_from(heap, 64) == blks[0]);
+
+        /* batch free sorts chain into pages, a block belongs to the page its header starts in */
+        pool_free_batch_from(heap, (void**)blks, blk_cnt);
+        assert(((uintptr_t)pool_malloc_from(heap, 64) - HDR_SIZE) / POOL_PAGE_SIZE == ((uintptr_t)blks[0] - HDR_SIZE) / POOL_PAGE_SIZE);
+        pool_destroy(heap);
+    }
+#endif
+
+#ifdef POOL_TRACE
+    /* test trace hooks and latency histograms - every single block op lands in one bucket */
+    {
+        static uint8_t mem[8192];
+        static void* blks[64];
+        size_t block_sizes[] = { 32, 128 };
+        pool_t* heap = pool_create(mem, sizeof(mem), block_sizes, 2);
+        assert(heap != NULL);
+
+        pool_lat_t lats[2];
+        pool_lat_t lat;
+        trace_log_t log = { 0 };
+        assert(!pool_get_lat_from(heap, 0, &lat));
+        assert(pool_set_trace_from(heap, trace_test, &log));
+        assert(pool_set_lat_from(heap, lats));
+
+        void* blk = pool_malloc_from(heap, 32);
+        assert(log.cnts[POOL_TRACE_ALLOC] == 1 && log.pool == 0 && log.ptr == blk && log.n == 32);
+        pool_free_from(heap, blk);
+        assert(log.cnts[POOL_TRACE_FREE] == 1 && log.pool == 0 && log.ptr == blk && log.n == 32);
+        pool_free_from(heap, blk);
+        assert(log.cnts[POOL_TRACE_FREE] == 1);
+
+        /* exhaust largest pool one block at a time */
+        pool_info_t info;
+        assert(pool_get_info_from(heap, 1, &info));
+        assert(info.blk_cnt < 64);
+        for (size_t i = 0; i < info.blk_cnt; i++) {
+            blks[i] = pool_malloc_from(heap, 128);
+        }
+        assert(pool_malloc_from(heap, 128) == NULL);
+        assert(log.cnts[POOL_TRACE_ALLOC] == 1 + info.blk_cnt && log.cnts[POOL_TRACE_EXHAUSTED] == 1);
+        assert(log.pool == 1 && log.ptr == NULL && log.n == 128);
+
+        /* failed request and invalid free not timed */
+        uint64_t mallocs[2] = { 0 };
+        uint64_t frees[2] = { 0 };
+        for (uint8_t i = 0; i < 2; i++) {
+            assert(pool_get_lat_from(heap, i, &lat));
+            for (uint8_t j = 0; j < POOL_LAT_BUCKETS; j++) {
+                mallocs[i] += lat.malloc_ticks[j];
+                frees[i] += lat.free_ticks[j];
+            }
+        }
+        assert(mallocs[0] == 1 && frees[0] == 1);
+        assert(mallocs[1] == info.blk_cnt + 1 && frees[1] == 0);
+
+        /* batch ops traced per block */
+        pool_free_batch_from(heap, blks, info.blk_cnt);
+        assert(log.cnts[POOL_TRACE_FREE] == 1 + info.blk_cnt);
+        size_t blk_cnt = pool_malloc_batch_from(heap, 128, blks, info.blk_cnt);
+        assert(blk_cnt == info.blk_cnt && log.cnts[POOL_TRACE_ALLOC] == 1 + 2 * info.blk_cnt);
+        pool_free_batch_from(heap, blks, blk_cnt);
+
+        /* hooks off */
+        assert(pool_set_trace_from(heap, NULL, NULL));
+        assert(pool_set_lat_from(heap, NULL));
+        pool_free_from(heap, pool_malloc_from(heap, 32));
+        assert(log.cnts[POOL_TRACE_FREE] == 1 + 2 * info.blk_cnt);
+        assert(!pool_get_lat_from(heap, 0, &lat));
+#ifdef POOL_CONCURRENT
+        pool_thread_flush();
+#endif
+        pool_destroy(heap);
+    }
+
+    /* test capture stream - header, then one record per op in order */
+    {
+        static uint8_t mem[8192];
+        size_t block_sizes[] = { 32, 128 };
+        pool_t* heap = pool_create(mem, sizeof(mem), block_sizes, 2);
+        FILE* out = tmpfile();
+        assert(heap != NULL && out != NULL);
+        assert(!pool_capture_start_from(heap, NULL));
+        assert(pool_capture_start_from(heap, out));
+
+        void* blk0 = pool_malloc_from(heap, 32);
+        void* blk1 = pool_malloc_from(heap, 128);
+        pool_free_from(heap, blk0);
+        pool_free_from(heap, blk0);
+        assert(pool_malloc_from(heap, 129) == NULL);
+        assert(pool_set_trace_from(heap, NULL, NULL));
+        pool_free_from(heap, blk1);
+
+        pool_capture_hdr_t hdr;
+        pool_capture_rec_t recs[4];
+        rewind(out);
+        assert(fread(&hdr, sizeof(hdr), 1, out) == 1);
+        assert(hdr.magic == POOL_CAPTURE_MAGIC && hdr.version == POOL_CAPTURE_VERSION);
+        assert(hdr.rec_size == sizeof(pool_capture_rec_t));
+        assert(fread(recs, sizeof(pool_capture_rec_t), 4, out) == 3);
+        assert(recs[0].op == POOL_TRACE_ALLOC && recs[0].handle == (uintptr_t)blk0 && recs[0].size == 32 && recs[0].pool == 0);
+        assert(recs[1].op == POOL_TRACE_ALLOC && recs[1].handle == (uintptr_t)blk1 && recs[1].size == 128 && recs[1].pool == 1);
+        assert(recs[2].op == POOL_TRACE_FREE && recs[2].handle == (uintptr_t)blk0 && recs[2].size == 32);
+        assert(recs[0].ticks <= recs[1].ticks && recs[1].ticks <= recs[2].ticks);
+        fclose(out);
+#ifdef POOL_CONCURRENT
+        pool_thread_flush();
+#endif
+        pool_destroy(heap);
+    }
+#endif
+
+    /* test default instance layout - even split */
+    {
+        pool_info_t info;
+        assert(pool_get_info(4, &info));
+        assert(info.blk_sz == 2048 && info.blk_cnt == 6);
+        assert(!pool_get_info(5, &info));
+
+#ifdef POOL_HEADERLESS
+        /* blocks carry no header */
+        assert(pool_get_info(0, &info));
+        assert(info.pool_bytes - info.slack_bytes == info.blk_cnt * (32 + CANARY_SIZE));
+#endif
+
+        /* payloads are naturally aligned */
+        for (uint8_t i = 0; i < 4; i++) {
+            size_t sizes[] = { 32, 128, 400, 512 };
+            assert(pool_get_info(i, &info) && info.blk_align == sizeof(void*));
+            void* blk = pool_malloc(sizes[i]);
+            assert(blk != NULL && (uintptr_t)blk % sizeof(void*) == 0);
+            pool_free(blk);
+        }
+    }
+
+#ifdef __unix__
+    /* test large mapped instance - more blocks per pool than 16 bit arithmetic allowed */
+    {
+        size_t len = 8 * 1024 * 1024;
+        void* mem = pool_map(&len, true);
+        assert(mem != NULL && len >= 8 * 1024 * 1024);
+
+        size_t block_sizes[] = { 16, MAX_BLOCK_SIZE };
+        pool_t* heap = pool_create(mem, len, block_sizes, 2);
+        assert(heap != NULL);
+
+        uint32_t blk_cnt = 0;
+        uint8_t* blk = NULL;
+        uint8_t* blk_last = NULL;
+        while ((blk = pool_malloc_from(heap, 16)) != NULL) {
+            blk_last = blk;
+            blk_cnt++;
+        }
+        assert(blk_cnt > 65536);
+        pool_free_from(heap, blk_last);
+        assert(pool_malloc_from(heap, 16) == blk_last);
+
+#ifdef POOL_CONCURRENT
+        pool_thread_flush();
+#endif
+        pool_destroy(heap);
+        pool_unmap(mem, len);
+    }
+
+    /* test elastic instance - exhausted pool grows by slabs, empty slabs returned to provider */
+    {
+        static _Alignas(64) uint8_t mem[4096];
+        size_t block_sizes[] = { 64 };
+        pool_cfg_t cfg = { .block_sizes = block_sizes, .block_size_count = 1,
+                           .slab_alloc = pool_slab_map, .slab_free = pool_slab_unmap,
+                           .slab_size = 4096, .slab_max = 4 };
+#ifdef POOL_LOCKFREE
+        /* growth not supported with tagged heads */
+        assert(pool_create_cfg(mem, sizeof(mem), &cfg) == NULL);
+#else
+        /* slab size must be a power of 2 */
+        cfg.slab_size = 3000;
+        assert(pool_create_cfg(mem, sizeof(mem), &cfg) == NULL);
+        cfg.slab_size = 4096;
+#ifndef POOL_CONCURRENT
+        cfg.slab_release = 8;
+#endif
+        pool_t* heap = pool_create_cfg(mem, sizeof(mem), &cfg);
+        assert(heap != NULL);
+
+        static uint8_t* blks[512];
+        pool_info_t info;
+        assert(pool_get_info_from(heap, 0, &info));
+        size_t fixed_blks = info.blk_cnt;
+        assert(info.slab_cnt == 0 && info.slab_blk_cnt == 0);
+
+        /* allocate past fixed blocks until slab_max slabs are used */
+        size_t blk_cnt = 0;
+        while ((blks[blk_cnt] = pool_malloc_from(heap, 64)) != NULL) {
+            blk_cnt++;
+        }
+        assert(pool_get_info_from(heap, 0, &info));
+        assert(info.slab_cnt == 4 && blk_cnt == fixed_blks + info.slab_blk_cnt);
+
+        /* slab blocks freed and double free detected like heap blocks - enable VERBOSE to verify */
+        pool_free_from(heap, blks[blk_cnt - 1]);
+        pool_free_from(heap, blks[blk_cnt - 1]);
+        assert(pool_malloc_from(heap, 64) == blks[blk_cnt - 1]);
+        assert(pool_malloc_from(heap, 64) == NULL);
+
+        for (size_t i = 0; i < blk_cnt; i++) {
+            pool_free_from(heap, blks[i]);
+        }
+        assert(pool_get_info_from(heap, 0, &info));
+#ifdef POOL_CONCURRENT
+        /* slabs kept until destroy */
+        assert(info.slab_cnt == 4);
+        pool_thread_flush();
+#else
+        /* fixed blocks alone keep pool above watermark, so every slab returned */
+        assert(info.slab_cnt == 0);
+        assert(pool_malloc_from(heap, 64) != NULL);
+#endif
+        pool_destroy(heap);
+#endif
+    }
+#endif
+
+#if defined(POOL_CONCURRENT) || defined(POOL_LOCKFREE)
+    /********************************/
+    /******* concurrent test ********/
+    /********************************/
+#ifdef VERBOSE
+    printf("\n------- concurrent test -------\n");
+#endif
+
+    /* test threads share a pool without corrupting it - every block returned after threads exit */
+    {
+        pool_stats_t stats_before[5];
+        for (uint8_t i = 0; i < 5; i++) {
+            assert(pool_get_stats(i, &stats_before[i]));
+        }
+        uint16_t free_before = count_free_blks(32);
+        pthread_t threads[THREAD_CNT];
+        for (uint8_t i = 0; i < THREAD_CNT; i++) {
+            assert(pthread_create(&threads[i], NULL, thread_test, (void*)(uintptr_t)(i + 1)) == 0);
+        }
+        for (uint8_t i = 0; i < THREAD_CNT; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        assert(count_free_blks(32) == free_before);
+
+        /* exited threads folded their counts, best fit may have served some from larger pools */
+        uint64_t allocs = 0;
+        for (uint8_t i = 0; i < 5; i++) {
+            pool_stats_t stats;
+            assert(pool_get_stats(i, &stats));
+            assert(stats.allocs - stats_before[i].allocs == stats.frees - stats_before[i].frees);
+            assert(stats.in_use == stats_before[i].in_use && stats.high_water >= stats_before[i].high_water);
+            allocs += stats.allocs - stats_before[i].allocs;
+        }
+        assert(allocs > 0);
+    }
+
+    /* test threads share a pool with batch calls - every block returned after threads exit */
+    {
+        uint16_t free_before = count_free_blks(32);
+        pthread_t threads[THREAD_CNT];
+        for (uint8_t i = 0; i < THREAD_CNT; i++) {
+            assert(pthread_create(&threads[i], NULL, thread_batch_test, (void*)(uintptr_t)(i + 1)) == 0);
+        }
+        for (uint8_t i = 0; i < THREAD_CNT; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        assert(count_free_blks(32) == free_before);
+    }
+
+    /* test blocks allocated on one thread and freed on another - every block returned after threads exit */
+    {
+        static thread_ring_t ring;
+        uint16_t free_before = count_free_blks(32);
+        ring.cnt = THREAD_ITRS;
+        pthread_t thread;
+        assert(pthread_create(&thread, NULL, thread_consumer_test, &ring) == 0);
+        for (size_t i = 0; i < ring.cnt; i++) {
+            while (ring.head - __atomic_load_n(&ring.tail, __ATOMIC_ACQUIRE) == THREAD_BLKS) {
+                sched_yield();
+            }
+            uint8_t* blk;
+            while ((blk = pool_malloc(32)) == NULL) {
+                sched_yield();
+            }
+            blk[0] = (uint8_t)i;
+            blk[31] = (uint8_t)i;
+            ring.slots[ring.head % THREAD_BLKS] = blk;
+            __atomic_store_n(&ring.head, ring.head + 1, __ATOMIC_RELEASE);
+        }
+        pthread_join(thread, NULL);
+#ifdef POOL_CONCURRENT
+        pool_thread_flush();
+#endif
+        assert(count_free_blks(32) == free_before);
+    }
+
+#ifdef POOL_CONCURRENT
+    /* test blocks freed by an exited thread wait on remote free stack until next allocation miss drains them */
+    {
+        static uint8_t mem[4096];
+        static void* blks[256];
+        size_t block_sizes[] = { 32 };
+        pool_t* heap = pool_create(mem, sizeof(mem), block_sizes, 1);
+        assert(heap != NULL);
+        pool_info_t info;
+        assert(pool_get_info_from(heap, 0, &info));
+        assert(info.blk_cnt <= 256);
+        assert(pool_malloc_batch_from(heap, 32, blks, info.blk_cnt) == info.blk_cnt);
+        assert(pool_malloc_from(heap, 32) == NULL);
+
+        g_remote_heap = heap;
+        g_remote_blks = blks;
+        g_remote_cnt = info.blk_cnt;
+        pthread_t thread;
+        assert(pthread_create(&thread, NULL, thread_remote_test, NULL) == 0);
+        pthread_join(thread, NULL);
+
+        /* shared list empty, every block comes back through the remote stack */
+        assert(pool_malloc_batch_from(heap, 32, blks, info.blk_cnt + 1) == info.blk_cnt);
+        for (size_t i = 0; i < info.blk_cnt; i++) {
+            pool_free_from(heap, blks[i]);
+        }
+        pool_thread_flush();
+        pool_destroy(heap);
+    }
+#endif
+
+    /* test threads share a bitmap pool - claims never overlap, every block findable after threads exit */
+    {
+        static uint8_t mem[4096];
+        static void* blks[2048];
+        size_t block_sizes[] = { 2 };
+        bool bitmaps[] = { true };
+        pool_cfg_t cfg = { .block_sizes = block_sizes, .block_size_count = 1, .bitmaps = bitmaps };
+        g_bmp_heap = pool_create_cfg(mem, sizeof(mem), &cfg);
+        assert(g_bmp_heap != NULL);
+        pool_info_t info;
+        assert(pool_get_info_from(g_bmp_heap, 0, &info));
+        assert(info.blk_cnt <= 2048);
+
+        pthread_t threads[THREAD_CNT];
+        for (uint8_t i = 0; i < THREAD_CNT; i++) {
+            assert(pthread_create(&threads[i], NULL, thread_bmp_test, (void*)(uintptr_t)(i + 1)) == 0);
+        }
+        for (uint8_t i = 0; i < THREAD_CNT; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        assert(pool_malloc_batch_from(g_bmp_heap, 2, blks, info.blk_cnt + 1) == info.blk_cnt);
+        pool_free_batch_from(g_bmp_heap, blks, info.blk_cnt);
+        pool_destroy(g_bmp_heap);
+    }
+#endif
+    /********************************/
+    /********* reset test ***********/
+    /********************************/
+#ifdef VERBOSE
+    printf("\n------- reset test -------\n");
+#endif
+
+    /* test pool reset - every block freed at once and handed out again, stale frees rejected */
+    {
+        static uint8_t mem[8192];
+        static void* blks[256];
+        size_t block_sizes[] = { 32, 128 };
+        pool_t* heap = pool_create(mem, sizeof(mem), block_sizes, 2);
+        assert(heap != NULL);
+        pool_info_t info;
+        assert(pool_get_info_from(heap, 0, &info) && info.blk_cnt <= 256);
+
+        uint8_t* blk_min = NULL;
+        for (size_t i = 0; i < info.blk_cnt; i++) {
+            blks[i] = pool_malloc_from(heap, 32);
+            assert(blks[i] != NULL);
+            if (blk_min == NULL || (uint8_t*)blks[i] < blk_min) {
+                blk_min = blks[i];
+            }
+        }
+        void* big = pool_malloc_from(heap, 128);
+        assert(big != NULL);
+
+        assert(pool_reset_from(heap, 0));
+        pool_stats_t stats;
+        assert(pool_get_stats_from(heap, 1, &stats) && stats.in_use == 1);
+        assert(pool_get_stats_from(heap, 0, &stats) && stats.in_use == 0 && stats.free_blks == info.blk_cnt);
+
+        /* stale pointer no longer allocated - enable VERBOSE to verify */
+        uint64_t frees = stats.frees;
+        pool_free_from(heap, blks[0]);
+#ifdef POOL_CONCURRENT
+        pool_thread_flush();
+#endif
+        assert(pool_get_stats_from(heap, 0, &stats) && stats.in_use == 0 && stats.frees == frees);
+
+        /* pool handed out again from its start */
+        blks[0] = pool_malloc_from(heap, 32);
+#ifndef POOL_CONCURRENT
+        assert(blks[0] == blk_min);
+#endif
+        for (size_t i = 1; i < info.blk_cnt; i++) {
+            blks[i] = pool_malloc_from(heap, 32);
+            assert(blks[i] != NULL && pool_owns_from(heap, blks[i]));
+        }
+#ifndef POOL_BEST_FIT
+        assert(pool_malloc_from(heap, 32) == NULL);
+#endif
+
+        /* every pool at once, invalid pools rejected */
+        assert(pool_reset_all_from(heap));
+        assert(pool_get_stats_from(heap, 0, &stats) && stats.in_use == 0);
+        assert(pool_get_stats_from(heap, 1, &stats) && stats.in_use == 0);
+        frees = stats.frees;
+        pool_free_from(heap, big);
+        assert(pool_get_stats_from(heap, 1, &stats) && stats.frees == frees);
+        assert(!pool_reset_from(heap, 2));
+        assert(!pool_reset_from(NULL, 0));
+        assert(!pool_reset(5));
+#ifdef POOL_CONCURRENT
+        pool_thread_flush();
+#endif
+        pool_destroy(heap);
+    }
+
+    /* test bitmap pool reset - bitmap cleared, lowest block found first again */
+    {
+        static uint8_t mem[8192];
+        static void* blks[2048];
+        size_t block_sizes[] = { 4 };
+        bool bitmaps[] = { true };
+        pool_cfg_t cfg = { .block_sizes = block_sizes, .block_size_count = 1, .bitmaps = bitmaps };
+        pool_t* heap = pool_create_cfg(mem, sizeof(mem), &cfg);
+        assert(heap != NULL);
+        pool_info_t info;
+        assert(pool_get_info_from(heap, 0, &info) && info.blk_cnt <= 2048);
+
+        assert(pool_malloc_batch_from(heap, 4, blks, info.blk_cnt) == info.blk_cnt);
+        assert(pool_reset_from(heap, 0));
+        pool_free_from(heap, blks[1]);
+        assert(pool_malloc_from(heap, 4) == blks[0]);
+        assert(pool_malloc_batch_from(heap, 4, blks + 1, info.blk_cnt) == info.blk_cnt - 1);
+        pool_stats_t stats;
+        assert(pool_get_stats_from(heap, 0, &stats) && stats.in_use == info.blk_cnt);
+#ifdef POOL_CONCURRENT
+        pool_thread_flush();
+#endif
+        pool_destroy(heap);
+    }
+
+#if defined(__unix__) && !defined(POOL_LOCKFREE)
+    /* test reset of grown pool - slabs returned to provider, pool grows again */
+    {
+        static _Alignas(64) uint8_t mem[4096];
+        static uint8_t* blks[512];
+        size_t block_sizes[] = { 64 };
+        pool_cfg_t cfg = { .block_sizes = block_sizes, .block_size_count = 1,
+                           .slab_alloc = pool_slab_map, .slab_free = pool_slab_unmap,
+                           .slab_size = 4096, .slab_max = 2 };
+        pool_t* heap = pool_create_cfg(mem, sizeof(mem), &cfg);
+        assert(heap != NULL);
+
+        size_t blk_cnt = 0;
+        while ((blks[blk_cnt] = pool_malloc_from(heap, 64)) != NULL) {
+            blk_cnt++;
+        }
+        pool_info_t info;
+        assert(pool_get_info_from(heap, 0, &info) && info.slab_cnt == 2);
+
+        assert(pool_reset_from(heap, 0));
+        assert(pool_get_info_from(heap, 0, &info) && info.slab_cnt == 0);
+        for (size_t i = 0; i < blk_cnt; i++) {
+            assert(pool_malloc_from(heap, 64) != NULL);
+        }
+        assert(pool_get_info_from(heap, 0, &info) && info.slab_cnt == 2);
+        assert(pool_malloc_from(heap, 64) == NULL);
+        assert(pool_reset_all_from(heap));
+#ifdef POOL_CONCURRENT
+        pool_thread_flush();
+#endif
+        pool_destroy(heap);
+    }
+#endif
+
+#ifdef POOL_CHECKPOINTS
+    /* test checkpoints - rollback frees every block allocated since, older blocks freed meanwhile are set aside */
+    {
+        static uint8_t mem[8192];
+        size_t block_sizes[] = { 32, 128 };
+        pool_t* heap = pool_create(mem, sizeof(mem), block_sizes, 2);
+        assert(heap != NULL);
+        pool_stats_t stats;
+
+        uint8_t* keep = pool_malloc_from(heap, 32);
+        uint8_t* early = pool_malloc_from(heap, 32);
+        assert(keep != NULL && early != NULL);
+        pool_free_from(heap, early);
+
+        pool_checkpoint_t outer;
+        assert(pool_get_stats_from(heap, 0, &stats));
+        uint64_t outer_use = stats.in_use;
+        assert(pool_checkpoint_from(heap, &outer));
+        uint8_t* blk = pool_malloc_from(heap, 32);
+        uint8_t* big = pool_malloc_from(heap, 128);
+        assert(blk != NULL && blk != early && big != NULL);
+
+        /* block from before checkpoint freed in scope is not handed out again in it */
+        pool_free_from(heap, keep);
+        pool_checkpoint_t inner;
+        assert(pool_get_stats_from(heap, 0, &stats));
+        uint64_t inner_use = stats.in_use;
+        assert(pool_checkpoint_from(heap, &inner));
+        uint8_t* inner_blk = pool_malloc_from(heap, 32);
+        assert(inner_blk != NULL && inner_blk != keep);
+
+        /* nor is a block of the outer scope freed in the inner one */
+        pool_free_from(heap, blk);
+        uint8_t* reused = pool_malloc_from(heap, 32);
+        assert(reused != NULL && reused != blk && reused != keep && reused != inner_blk);
+        assert(!pool_rollback(&outer));
+        assert(pool_rollback(&inner));
+        assert(pool_get_stats_from(heap, 0, &stats) && stats.in_use == inner_use - 1);
+
+        /* outer scope gets its own block back, both stay allocated until rollback */
+        assert(pool_malloc_from(heap, 32) == blk);
+        assert(pool_malloc_from(heap, 32) == inner_blk);
+        assert(pool_rollback(&outer));
+
+        /* in use back to checkpoint, less the older block freed in scope */
+        assert(pool_get_stats_from(heap, 0, &stats) && stats.in_use == outer_use - 1);
+        assert(pool_get_stats_from(heap, 1, &stats) && stats.in_use == 0);
+
+        assert(pool_malloc_from(heap, 32) == keep);
+        assert(pool_malloc_from(heap, 32) == early);
+        assert(pool_malloc_from(heap, 32) == blk);
+        assert(pool_malloc_from(heap, 128) == big);
+
+        /* stale pointer from rolled back scope - enable VERBOSE to verify */
+        pool_free_from(heap, inner_blk);
+        assert(pool_get_stats_from(heap, 0, &stats) && stats.in_use == 3);
+
+        /* allocation after freeing an older block is freed by rollback */
+        pool_checkpoint_t scope;
+        assert(pool_checkpoint_from(heap, &scope));
+        pool_free_from(heap, keep);
+        uint8_t* next = pool_malloc_from(heap, 32);
+        assert(next != NULL && next != keep);
+        assert(pool_rollback(&scope));
+        assert(pool_get_stats_from(heap, 0, &stats) && stats.in_use == 2);
+
+        /* closed checkpoints rejected, reset closes open ones */
+        assert(!pool_rollback(&outer));
+        assert(!pool_rollback(NULL));
+        assert(!pool_checkpoint_from(NULL, &outer));
+        assert(pool_checkpoint_from(heap, &outer));
+        assert(pool_reset_all_from(heap));
+        assert(!pool_rollback(&outer));
+
+        /* blocks of other pools set aside by checkpoints closed by reset of one pool are handed out again */
+        uint8_t* bigs[64];
+        size_t big_cnt = 0;
+        while ((bigs[big_cnt] = pool_malloc_from(heap, 128)) != NULL) {
+            big_cnt++;
+        }
+        assert(big_cnt > 0 && big_cnt < 64);
+        assert(pool_checkpoint_from(heap, &outer));
+        assert(pool_checkpoint_from(heap, &inner));
+        for (size_t i = 0; i < big_cnt; i++) {
+            pool_free_from(heap, bigs[i]);
+        }
+        assert(pool_reset_from(heap, 0));
+        assert(!pool_rollback(&inner));
+        assert(!pool_rollback(&outer));
+        for (size_t i = 0; i < big_cnt; i++) {
+            assert(pool_malloc_from(heap, 128) != NULL);
+        }
+        assert(pool_malloc_from(heap, 128) == NULL);
+        assert(pool_get_stats_from(heap, 1, &stats) && stats.in_use == big_cnt);
+        pool_destroy(heap);
+
+        /* no checkpoints for bitmap pools */
+        bool bitmaps[] = { true, false };
+        pool_cfg_t cfg = { .block_sizes = block_sizes, .block_size_count = 2, .bitmaps = bitmaps };
+        heap = pool_create_cfg(mem, sizeof(mem), &cfg);
+        assert(heap != NULL);
+        assert(!pool_checkpoint_from(heap, &outer));
+        pool_destroy(heap);
+    }
+#endif
+
+#if defined(POOL_CANARY) || defined(POOL_POISON)
+    /********************************/
+    /******* hardening test *********/
+    /********************************/
+#ifdef VERBOSE
+    printf("\n------- hardening test -------\n");
+#endif
+
+    /* test corrupted blocks counted as faults */
+    {
+        static uint8_t mem[4096];
+        size_t block_sizes[] = { 32 };
+        pool_t* heap = pool_create(mem, sizeof(mem), block_sizes, 1);
+        assert(heap != NULL);
+#if defined(POOL_CANARY) || !defined(__SANITIZE_ADDRESS__)
+        pool_stats_t stats;
+#endif
+
+#ifdef POOL_CANARY
+        /* one byte overflow into the canary, block left allocated */
+        uint8_t* blk = pool_malloc_from(heap, 32);
+        assert(blk != NULL);
+        blk[32] ^= 1;
+        pool_free_from(heap, blk);
+        assert(pool_get_stats_from(heap, 0, &stats) && stats.faults == 1 && stats.in_use == 1);
+
+        /* in bounds writes pass */
+        blk = pool_malloc_from(heap, 32);
+        assert(blk != NULL);
+        for (uint8_t i = 0; i < 32; i++) {
+            blk[i] = i;
+        }
+        pool_free_from(heap, blk);
+        assert(pool_get_stats_from(heap, 0, &stats) && stats.faults == 1 && stats.in_use == 1);
+#endif
+
+#if defined(POOL_POISON) && !defined(__SANITIZE_ADDRESS__)
+        /* write past the link word of a free block, caught when handed out again */
+        assert(pool_get_stats_from(heap, 0, &stats));
+        uint64_t faults = stats.faults;
+        uint8_t* stale = pool_malloc_from(heap, 32);
+        assert(stale != NULL);
+        pool_free_from(heap, stale);
+        stale[16] = 0;
+        assert(pool_malloc_from(heap, 32) == stale);
+        assert(pool_get_stats_from(heap, 0, &stats) && stats.faults == faults + 1);
+        pool_free_from(heap, stale);
+        assert(pool_malloc_from(heap, 32) == stale);
+        assert(pool_get_stats_from(heap, 0, &stats) && stats.faults == faults + 1);
+        pool_free_from(heap, stale);
+#endif
+
+#ifdef POOL_CONCURRENT
+        pool_thread_flush();
+#endif
+        pool_destroy(heap);
+    }
+#endif
+
+#ifdef POOL_NUMA
+    /********************************/
+    /********** numa test ***********/
+    /********************************/
+#ifdef VERBOSE
+    printf("\n------- numa test -------\n");
+#endif
+
+    /* test blocks served from the caller's node and freed back to their home node from any node */
+    {
+        pool_t* node0 = pool_numa_heap(0);
+        pool_t* node1 = pool_numa_heap(1);
+        assert(node0 != NULL && node1 != NULL && node0 != node1 && pool_numa_heap(2) == NULL);
+        pool_stats_t stats0;
+        pool_stats_t stats1;
+        assert(pool_get_stats_from(node0, 0, &stats0) && pool_get_stats_from(node1, 0, &stats1));
+        uint64_t in_use0 = stats0.in_use;
+        uint64_t in_use1 = stats1.in_use;
+
+        void* blks[8];
+        for (uint8_t i = 0; i < 8; i++) {
+            pool_numa_set_node(i % 2 == 0 ? 0 : 3);
+            blks[i] = pool_malloc(32);
+            assert(blks[i] != NULL && pool_owns_from(i % 2 == 0 ? node0 : node1, blks[i]) && pool_owns(blks[i]));
+        }
+        assert(pool_get_stats(0, &stats1) && stats1.in_use == in_use1 + 4);
+        void* batch[1];
+        assert(pool_malloc_batch(32, batch, 1) == 1 && pool_owns_from(node1, batch[0]));
+        pool_free(batch[0]);
+
+        /* node 0 frees node 1 blocks, batch mixes both nodes */
+        pool_numa_set_node(0);
+        pool_free(blks[0]);
+        pool_free(blks[1]);
+        pool_free_batch(blks + 2, 6);
+#ifdef POOL_CONCURRENT
+        pool_thread_flush();
+#endif
+        assert(pool_get_stats_from(node0, 0, &stats0) && pool_get_stats_from(node1, 0, &stats1));
+        assert(stats0.in_use == in_use0 && stats1.in_use == in_use1);
+
+        /* node detected from cpu again */
+        pool_numa_set_node(-1);
+        void* blk = pool_malloc(32);
+        assert(blk != NULL && pool_owns(blk));
+        pool_free(blk);
+        pool_numa_set_node(0);
+
+        size_t block_sizes[] = { 32 };
+        pool_cfg_t cfg = { .block_sizes = block_sizes, .block_size_count = 1 };
+        assert(!pool_init_numa(&cfg, 2));
+    }
+#endif
+
     /********************************/
     /******* functional test ********/
     /********************************/
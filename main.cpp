@@ -0,0 +1,279 @@
+#include <cstdio>
+#include <cstddef>
+#include <cstdint>
+#include <cassert>
+#include <list>
+#include <map>
+#include <memory_resource>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "pool_alloc.hpp"
+
+/* layout resolved at compile time */
+using test_alloc_t = pool_alloc<12, 32, 100, 2048>;
+static_assert(test_alloc_t::pool_cnt == 4, "pool count");
+static_assert(test_alloc_t::pool_of(1) == 0 && test_alloc_t::pool_of(12) == 0, "smallest pool");
+static_assert(test_alloc_t::pool_of(13) == 1 && test_alloc_t::pool_of(100) == 2, "best fit pool");
+static_assert(test_alloc_t::pool_of(0) == test_alloc_t::pool_none, "0 bytes rejected");
+static_assert(test_alloc_t::pool_of(2049) == test_alloc_t::pool_none, "too large rejected");
+static_assert(test_alloc_t::blk_stride(0) == 16 && test_alloc_t::blk_stride(2) == 104, "stride holds link");
+static_assert(test_alloc_t::blk_align(0) == 16 && test_alloc_t::blk_align(2) == 8, "alignment from stride");
+static_assert(test_alloc_t::pool_offset(3) == 3 * test_alloc_t::pool_share, "even split");
+static_assert(test_alloc_t::blk_cnt(3) == POOL_HEAP_SIZE / 4 / 2048, "largest pool");
+
+struct msg_t {
+    uint64_t id;
+    double val[2];
+};
+
+/* allocator holds its heap, keep it out of the stack */
+static test_alloc_t g_alloc;
+
+/* libstdc++ node sizes on 64 bit targets, pools are checked only where they are known */
+#if defined(__GLIBCXX__) && UINTPTR_MAX == UINT64_MAX
+#define NODE_SIZES_KNOWN
+#endif
+
+/* node sizes of std::unordered_map<int, int>, std::list<int> and std::map<int, int> */
+static const size_t g_node_sizes[] = { 16, 24, 40, 256 };
+static const size_t g_node_aligns[] = { 16, 16, 16, 16 };
+
+/* object whose constructor throws on request */
+struct obj_t {
+    int val;
+    explicit obj_t(int v) : val(v) {
+        if (v < 0) {
+            throw std::invalid_argument("negative");
+        }
+    }
+};
+
+#ifdef POOL_BEST_FIT
+static uint64_t pool_allocs(pool_t* heap, uint8_t pool) {
+    pool_stats_t stats;
+    assert(pool_get_stats_from(heap, pool, &stats));
+    return stats.allocs;
+}
+#endif
+
+static uint64_t pool_in_use(pool_t* heap, uint8_t pool) {
+    pool_stats_t stats;
+    assert(pool_get_stats_from(heap, pool, &stats));
+    return stats.in_use;
+}
+
+int main() {
+#ifdef VERBOSE
+    printf("\n------- pool_alloc<Sizes...> test -------\n");
+#endif
+
+    /* test every block of a pool handed out once, aligned, then exhausted */
+    {
+        static void* blks[POOL_HEAP_SIZE / 4 / 16];
+        size_t cnt = test_alloc_t::blk_cnt(0);
+        assert(g_alloc.free_cnt(0) == cnt);
+        for (size_t i = 0; i < cnt; i++) {
+            blks[i] = g_alloc.allocate<12>();
+            assert(blks[i] != nullptr && g_alloc.owns(blks[i]));
+            assert((uintptr_t)blks[i] % test_alloc_t::blk_align(0) == 0);
+            *(uint64_t*)blks[i] = i;
+        }
+        assert(g_alloc.allocate<12>() == nullptr);
+        assert(g_alloc.allocate(5) == nullptr);
+        for (size_t i = 0; i < cnt; i++) {
+            assert(*(uint64_t*)blks[i] == i);
+        }
+
+        /* mixed static, typed and runtime frees */
+        g_alloc.deallocate<12>(blks[0]);
+        g_alloc.deallocate(blks[1]);
+        g_alloc.deallocate<8>(blks[2]);
+        assert(g_alloc.free_cnt(0) == 3);
+        assert(g_alloc.allocate(1) == blks[2]);
+        for (size_t i = 3; i < cnt; i++) {
+            g_alloc.deallocate(blks[i]);
+        }
+        g_alloc.deallocate(blks[2]);
+        g_alloc.deallocate(nullptr);
+        assert(g_alloc.free_cnt(0) == cnt);
+    }
+
+    /* test typed allocation lands in smallest pool holding the type */
+    {
+        msg_t* msg = g_alloc.allocate<msg_t>();
+        assert(msg != nullptr);
+        assert((uintptr_t)g_alloc.allocate<32>() - (uintptr_t)msg == test_alloc_t::blk_stride(1));
+        assert(g_alloc.free_cnt(1) == test_alloc_t::blk_cnt(1) - 2);
+        msg->id = 1;
+        g_alloc.deallocate(msg);
+        assert(g_alloc.free_cnt(1) == test_alloc_t::blk_cnt(1) - 1);
+    }
+
+    /* test runtime sizes and foreign pointers */
+    {
+        static uint8_t other[64];
+        assert(g_alloc.allocate(2049) == nullptr);
+        assert(g_alloc.allocate(0) == nullptr);
+        void* blk = g_alloc.allocate(2048);
+        assert(blk != nullptr && g_alloc.owns(blk));
+        assert(!g_alloc.owns((uint8_t*)blk + 1));
+        assert(!g_alloc.owns(other));
+        g_alloc.deallocate<2048>(blk);
+    }
+
+    /* test C API unaffected alongside */
+    {
+        size_t block_sizes[] = { 32, 64 };
+        assert(pool_init(block_sizes, 2));
+        void* blk = pool_malloc(32);
+        assert(blk != nullptr);
+        pool_free(blk);
+    }
+
+#ifdef VERBOSE
+    printf("\n------- STL adaptor test -------\n");
+#endif
+
+    /* test node containers on a C instance, nodes past pool capacity and bucket arrays go to operator new */
+    {
+        static uint8_t mem[16384];
+        pool_cfg_t cfg = { 0 };
+        cfg.block_sizes = g_node_sizes;
+        cfg.block_size_count = 4;
+        cfg.alignments = g_node_aligns;
+        pool_t* heap = pool_create_cfg(mem, sizeof(mem), &cfg);
+        assert(heap != nullptr);
+
+        pool_allocator<int> alloc(heap);
+        assert(alloc == pool_allocator<double>(heap) && alloc != pool_allocator<int>());
+        {
+            std::list<int, pool_allocator<int>> list(alloc);
+            pool_info_t info;
+            assert(pool_get_info_from(heap, 1, &info));
+            for (int i = 0; i < (int)info.blk_cnt + 100; i++) {
+                list.push_back(i);
+            }
+            int i = 0;
+            for (int val : list) {
+                assert(val == i++);
+            }
+#ifdef NODE_SIZES_KNOWN
+            assert(pool_in_use(heap, 1) == info.blk_cnt);
+            assert(pool_owns_from(heap, &list.front()) && !pool_owns_from(heap, &list.back()));
+#endif
+        }
+        assert(pool_in_use(heap, 1) == 0);
+
+        {
+            std::unordered_map<int, int, std::hash<int>, std::equal_to<int>, pool_allocator<std::pair<const int, int>>> map(alloc);
+            for (int i = 0; i < 100; i++) {
+                map[i] = 2 * i;
+            }
+            for (int i = 0; i < 100; i++) {
+                assert(map.at(i) == 2 * i);
+            }
+#ifdef NODE_SIZES_KNOWN
+            assert(pool_in_use(heap, 0) == 100);
+#endif
+        }
+        assert(pool_in_use(heap, 0) == 0);
+
+        /* pmr containers share one resource, oversized requests go upstream */
+        pool_resource res(heap);
+        assert(res.is_equal(pool_resource(heap)) && !res.is_equal(*std::pmr::new_delete_resource()));
+        {
+            std::pmr::map<int, int> map(&res);
+            for (int i = 0; i < 50; i++) {
+                map[i] = i;
+            }
+#ifdef NODE_SIZES_KNOWN
+            assert(pool_in_use(heap, 2) == 50);
+#endif
+            void* big = res.allocate(4096, 8);
+            assert(!pool_owns_from(heap, big));
+            res.deallocate(big, 4096, 8);
+            void* blk = res.allocate(256, 16);
+            assert(pool_owns_from(heap, blk) && (uintptr_t)blk % 16 == 0);
+            res.deallocate(blk, 256, 16);
+        }
+        assert(pool_in_use(heap, 2) == 0 && pool_in_use(heap, 3) == 0);
+
+        /* typed pool constructs in place, block returned when constructor throws */
+        object_pool<obj_t> objs(heap);
+#ifndef POOL_BEST_FIT
+        /* 4 byte object, no pool of that exact size */
+        assert(objs.construct(7) == nullptr);
+#else
+        uint64_t allocs = pool_allocs(heap, 0) + pool_allocs(heap, 1) + pool_allocs(heap, 2) + pool_allocs(heap, 3);
+        obj_t* obj = objs.construct(7);
+        assert(obj != nullptr && obj->val == 7 && pool_owns_from(heap, obj));
+        objs.destroy(obj);
+        bool thrown = false;
+        try {
+            objs.construct(-1);
+        }
+        catch (const std::invalid_argument&) {
+            thrown = true;
+        }
+        assert(thrown && pool_in_use(heap, 0) == 0);
+        assert(pool_allocs(heap, 0) + pool_allocs(heap, 1) + pool_allocs(heap, 2) + pool_allocs(heap, 3) == allocs + 2);
+#endif
+        objs.destroy(nullptr);
+
+#ifdef POOL_CONCURRENT
+        pool_thread_flush();
+#endif
+        pool_destroy(heap);
+    }
+
+    /* test typed pool of a block sized type on default instance */
+    {
+        struct msg32_t {
+            uint64_t words[4];
+        };
+        object_pool<msg32_t> msgs;
+        msg32_t* msg = msgs.construct(msg32_t{ { 1, 2, 3, 4 } });
+        assert(msg != nullptr && msg->words[3] == 4 && pool_owns(msg));
+        msgs.destroy(msg);
+    }
+
+#ifdef POOL_CHECKPOINTS
+    /* test scope returns blocks allocated while open, scopes nest */
+    {
+        static uint8_t mem[4096];
+        size_t block_sizes[] = { 64 };
+        pool_t* heap = pool_create(mem, sizeof(mem), block_sizes, 1);
+        assert(heap != nullptr);
+        void* keep = pool_malloc_from(heap, 64);
+        {
+            pool_scope scope(heap);
+            assert(scope);
+            for (int i = 0; i < 10; i++) {
+                assert(pool_malloc_from(heap, 64) != nullptr);
+            }
+            {
+                pool_scope inner(heap);
+                assert(inner && pool_malloc_from(heap, 64) != nullptr);
+                assert(pool_in_use(heap, 0) == 12);
+            }
+            assert(pool_in_use(heap, 0) == 11);
+        }
+        assert(pool_in_use(heap, 0) == 1);
+        pool_free_from(heap, keep);
+
+        /* default instance has growth disabled and free list pools */
+        {
+            pool_scope scope;
+            assert(scope);
+        }
+        pool_destroy(heap);
+    }
+#endif
+
+#ifdef POOL_CONCURRENT
+    pool_thread_flush();
+#endif
+    printf("\nSUCCESS: all C++ assertions passed\n");
+    return 0;
+}
@@ -10,346 +10,3870 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <assert.h> // internal sanity checks
+#ifdef POOL_CONCURRENT
+#include <pthread.h>
+#endif
+#ifdef __unix__
+#include <sys/mman.h>
+#endif
+#ifdef POOL_NUMA
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+#if defined(POOL_CANARY) || defined(POOL_POISON)
+#include <string.h>
+#endif
+#if defined(POOL_CANARY) || defined(POOL_ENCODE)
+#include <time.h>
+#endif
+#ifdef POOL_TRACE
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+#endif
+
+#include "pool_alloc.h"
+
+#if defined(POOL_CONCURRENT) && defined(POOL_LOCKFREE)
+#error "POOL_CONCURRENT and POOL_LOCKFREE are alternative thread safe modes, select one"
+#endif
+
+#if defined(POOL_PARANOID) && defined(POOL_LOCKFREE)
+#error "POOL_PARANOID free list walk is not safe with POOL_LOCKFREE"
+#endif
+
+#if defined(POOL_LOCALITY) && (defined(POOL_CONCURRENT) || defined(POOL_LOCKFREE))
+#error "POOL_LOCALITY page free lists are not thread safe, POOL_CONCURRENT magazines already keep hot blocks per thread"
+#endif
+
+#if defined(POOL_NUMA) && !defined(__linux__)
+#error "POOL_NUMA needs Linux mbind and getcpu"
+#endif
+
+/* internal - free blocks are poisoned for AddressSanitizer or Valgrind memcheck */
+#if defined(__SANITIZE_ADDRESS__)
+#define BLK_ASAN
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define BLK_ASAN
+#endif
+#endif
+
+#if defined(BLK_ASAN)
+#include <sanitizer/asan_interface.h>
+#define BLK_ANNOTATE
+#define BLK_NOACCESS(ptr, len) ASAN_POISON_MEMORY_REGION(ptr, len)
+#define BLK_ACCESS(ptr, len) ASAN_UNPOISON_MEMORY_REGION(ptr, len)
+#define BLK_UNDEFINED(ptr, len) ((void)(ptr), (void)(len))
+#elif defined(POOL_VALGRIND)
+#include <valgrind/memcheck.h>
+#define BLK_ANNOTATE
+#define BLK_NOACCESS(ptr, len) VALGRIND_MAKE_MEM_NOACCESS(ptr, len)
+#define BLK_ACCESS(ptr, len) VALGRIND_MAKE_MEM_DEFINED(ptr, len)
+#define BLK_UNDEFINED(ptr, len) VALGRIND_MAKE_MEM_UNDEFINED(ptr, len)
+#endif
+
+/* internal - free blocks are filled or poisoned on free, checked or unpoisoned on malloc */
+#if defined(POOL_POISON) || defined(BLK_ANNOTATE)
+#define BLK_GUARDED
+#endif
+
+/* internal - free lists and bitmaps are shared between threads */
+#if defined(POOL_CONCURRENT) || defined(POOL_LOCKFREE)
+#define POOL_THREADED
+#endif
+
+#ifdef POOL_LOCKFREE
+/* tagged free list head - generation in upper 32 bits, heap offset of first free block in lower 32 bits */
+/* note: offset 0 is heap mgmt data so never a block, used for empty list */
+typedef uint64_t blk_head_t;
+#define BLK_HEAD_PACK(heap, gen, blk) (((uint64_t)(gen) << 32) | (uint32_t)((blk) == NULL ? 0 : (uint8_t*)(blk) - (heap)->heap))
+#define BLK_HEAD_GEN(head) ((uint32_t)((head) >> 32))
+#define BLK_HEAD_BLK(heap, head) ((uint32_t)(head) == 0 ? NULL : (heap)->heap + (uint32_t)(head))
+#define BLK_HEAD(heap, pool) blk_head_load(heap, pool)
+#else
+typedef uint8_t* blk_head_t;
+#define BLK_HEAD_PACK(heap, gen, blk) (blk)
+#define BLK_HEAD(heap, pool) ((heap)->blk_alloc[pool])
+#endif
+
+#define CACHE_LINE 64
+
+/* # of blocks of a pool handed out since init or reset, every block of a bitmap pool */
+#ifdef POOL_CONCURRENT
+#define BLK_CARVED(heap, pool) ((heap)->pool_locks[pool].carved)
+#else
+#define BLK_CARVED(heap, pool) ((heap)->blk_carved[pool])
+#endif
+
+#ifdef POOL_CONCURRENT
+/* per-pool lock of shared free list, padded so pools do not share a cache line */
+/* carved count shares the line, it is bumped by the same refills that take the lock */
+typedef union {
+    struct {
+        pthread_mutex_t mtx;
+        uint32_t carved;
+    };
+    uint8_t pad[CACHE_LINE];
+} pool_lock_t;
+
+/* per-pool stack of blocks freed back by thread caches, pushed without the pool lock */
+/* padded apart from pool locks so freeing threads do not contend with allocating ones */
+typedef union {
+    uint8_t* head;
+    uint8_t pad[CACHE_LINE];
+} pool_remote_t;
+#endif
+
+#ifdef POOL_LOCALITY
+#if (POOL_PAGE_SIZE & (POOL_PAGE_SIZE - 1)) != 0
+#error "POOL_PAGE_SIZE must be a power of 2"
+#endif
+
+/* free blocks of a pool grouped by the page they start in, each page with its own free list */
+typedef struct {
+    uint8_t** heads;              // first free block of each page, most recently freed first
+    uint64_t* map;                // bit set = page has free blocks
+    uint8_t* page_min;            // page aligned address below first block
+    uint32_t page_cnt;            // # of pages blocks start in
+    uint32_t page_low;            // lowest page with free blocks, page_cnt if none
+} blk_pages_t;
+#endif
+
+/* free block search of a bitmap pool, blocks are found in the allocation bitmap instead of a free list */
+typedef struct {
+    uint64_t* sums;               // summary bitmap, bit set = allocation bitmap word full, NULL for free list pools
+    size_t low;                   // lowest allocation bitmap word that may have a free block, a hint with POOL_THREADED
+} blk_bmp_t;
+
+/* slab a pool has grown by, header at start of slab followed by its bitmap and blocks */
+typedef struct pool_slab {
+    uint8_t* base;                // first block
+    uint32_t blk_cnt;             // # of blocks in slab
+    uint32_t blk_used;            // # of allocated blocks, only tracked without POOL_THREADED
+    uint8_t pool;                 // pool index slab belongs to
+    uint64_t map[];               // allocation bitmap, bit set = block allocated
+} pool_slab_t;
+
+/* usage counters of a pool, in use and free blocks are derived from them */
+#define BLK_STAT_ALLOC 0
+#define BLK_STAT_FREE 1
+#define BLK_STAT_FAIL 2
+#define BLK_STAT_CNT 3
+
+typedef struct {
+    uint64_t cnts[BLK_STAT_CNT];  // allocs, frees, failures
+    uint64_t high_water;          // most blocks allocated at once
+#if defined(POOL_CANARY) || defined(POOL_POISON)
+    uint64_t faults;              // corrupted blocks detected
+#endif
+} blk_stat_t;
+
+/* usage counts of a pool not yet added to shared counters */
+typedef struct {
+    uint16_t cnts[BLK_STAT_CNT];  // allocs, frees, failures
+    uint16_t peak;                // most of allocs - frees reached while counting
+} blk_stat_pend_t;
+
+/* allocator instance, stored at start of the memory it manages */
+struct pool {
+    uint32_t magic;               // POOL_MAGIC while instance is valid
+    uint32_t id;                  // unique instance id
+    uint8_t* heap;                // start of heap (this struct)
+    uint8_t* heap_max;            // end of heap
+
+    uint8_t blk_sz_cnt;           // # of block sizes = # of pools
+    uint16_t* blk_szs;            // block_sizes array
+    uint16_t* blk_aligns;         // block data alignment of each pool
+    uint16_t* blk_mem_reqs;       // mem requirement of each block of each pool, see BLK_MEM_REQ
+    uint8_t** pool_base_addrs;    // base addresses of pools
+    uint8_t* pool_max;            // end of last pool
+    blk_head_t* blk_alloc;        // next block address to be allocated
+    uint32_t* blk_cnts;           // # of blocks in each pool
+#ifndef POOL_CONCURRENT
+    uint32_t* blk_carved;         // # of blocks of each pool handed out since init or reset, blocks past it are untouched
+#endif
+    uint8_t* blk_pools;           // pool index for each block size 0..MAX_BLOCK_SIZE
+    uint64_t** blk_maps;          // allocation bitmap of each pool, bit set = block allocated
+    blk_stat_t* blk_stats;        // usage counters of each pool
+    blk_bmp_t* blk_bmps;          // bitmap search of each pool, NULL if no pool is a bitmap pool
+#ifdef POOL_LOCALITY
+    blk_pages_t* blk_pages;       // page free lists of each pool, blk_alloc then only lists slab blocks
+#endif
+#ifdef POOL_BEST_FIT
+    uint8_t* blk_next;            // next larger pool of each pool, POOL_NONE if largest
+    pool_frag_t* blk_frags;       // internal fragmentation counters of each pool
+#endif
+#ifdef POOL_CONCURRENT
+    pool_lock_t* pool_locks;      // lock of each pool free list
+    pool_remote_t* blk_remotes;   // remote free stack of each pool, drained into blk_alloc under pool lock
+#endif
+#ifdef POOL_TRACE
+    pool_lat_t* blk_lats;         // latency histograms of each pool in caller memory, NULL if not recording
+    pool_trace_t trace;           // trace hook, NULL if none
+    void* trace_ctx;              // passed to trace hook
+#endif
+
+    pool_slab_alloc_t slab_alloc; // slab provider, NULL if pools cannot grow
+    pool_slab_free_t slab_free;   // return slab to provider, NULL if slabs are kept until pool_destroy
+    void* slab_ctx;               // passed to slab provider
+    size_t slab_size;             // bytes per slab, power of 2
+    size_t slab_max;              // capacity of slabs
+    size_t slab_release;          // free blocks a pool keeps when releasing an empty slab, 0 = never release
+    size_t slab_cnt;              // # of slabs
+    pool_slab_t** slabs;          // slabs of all pools sorted by address
+    size_t* blk_avail;            // # of free blocks of each pool, NULL unless slabs are released
+#ifdef POOL_CONCURRENT
+    pthread_rwlock_t slab_lock;   // read to look up slabs, write to add slabs
+#endif
+#ifdef POOL_CHECKPOINTS
+    pool_checkpoint_t* ckpt;      // innermost open checkpoint, NULL if none
+#endif
+};
+
+/* marks valid instance, catches use of destroyed or foreign pool_t */
+#define POOL_MAGIC 0x504F4F4C
+
+/* default instance used by pool_init/pool_malloc/pool_free */
+static _Alignas(CACHE_LINE) uint8_t g_pool_heap[POOL_HEAP_SIZE];
+static pool_t* g_pool = NULL;
+
+#ifdef POOL_NUMA
+#if POOL_NUMA_NODES > 64
+#error "POOL_NUMA_NODES must fit a 64 bit node mask"
+#endif
+
+/* mbind policy, from linux/mempolicy.h */
+#define NUMA_MPOL_BIND 2
+
+/* # of default instance calls a thread serves from its cached node before asking the kernel again */
+#define NUMA_NODE_REFRESH 4096
+
+/* default instance of each node, g_pool is node 0, none unless pool_init_numa */
+static pool_t* g_numa_pools[POOL_NUMA_NODES];
+static uint8_t g_numa_cnt = 0;
+
+static __thread int tls_numa_node = -1;   // node set by pool_numa_set_node, -1 = detect
+static __thread uint32_t tls_numa_seen;   // node detected for thread by getcpu
+static __thread uint32_t tls_numa_ops;    // calls left until node is detected again
+#endif
+
+/* source of unique instance ids */
+static uint32_t g_pool_ids = 0;
+
+#if defined(POOL_CANARY) || defined(POOL_ENCODE)
+/* random key of canaries and link masks, set by first pool_create */
+static uint64_t g_blk_key = 0;
+#endif
+
+/* bitmap helpers - one bit per block, indexed by block number within pool */
+#define BLK_MAP_BITS 64
+#define BLK_MAP_WORDS(blks) (((blks) + BLK_MAP_BITS - 1) / BLK_MAP_BITS)
+#define BLK_MAP_MASK(blk) ((uint64_t)1 << ((blk) % BLK_MAP_BITS))
+#define BLK_MAP_WORD(map, blk) ((map)[(blk) / BLK_MAP_BITS])
+
+#ifdef POOL_HEADERLESS
+/* free list link stored in payload of free block, allocated blocks carry no header */
+#define BLK_HDR_SIZE 0
+#else
+/* free list link stored in header in front of block data */
+#define BLK_HDR_SIZE sizeof(uint8_t*)
+#endif
+
+/* free list pool blocks aligned to hold the link, so block data of pointer sized or smaller types is naturally aligned */
+#define BLK_ALIGN_MIN sizeof(uint8_t*)
+
+/* mem requirement for each block - header + block data, rounded up so every block data is aligned */
+#define BLK_MEM_REQ(blk_sz, hdr, align) (((size_t)(blk_sz) + (hdr) + (align) - 1) / (align) * (align))
+
+/* offset from ptr to first block whose data is aligned */
+#define BLK_ALIGN_OFF(ptr, hdr, align) (((align) - ((uintptr_t)(ptr) + (hdr)) % (align)) % (align))
+
+#ifdef POOL_CANARY
+/* tail canary after block data of free list pools, checked on free */
+#define BLK_CANARY_SIZE sizeof(uint64_t)
+#define BLK_CANARY(blk_data) (g_blk_key * 0x9E3779B97F4A7C15ULL ^ (uintptr_t)(blk_data))
+#else
+#define BLK_CANARY_SIZE 0
+#endif
+
+#ifdef POOL_POISON
+/* byte pattern filling data of free blocks, checked on malloc */
+#define BLK_POISON_BYTE 0xA5
+#endif
+
+#ifdef POOL_ENCODE
+/* free list link stored masked with process key and its own address, an overwritten link decodes to garbage */
+#define BLK_ENC(pos, ptr) ((uint8_t*)((uintptr_t)(ptr) ^ ((uintptr_t)(pos) >> 12) ^ g_blk_key))
+#else
+#define BLK_ENC(pos, ptr) ((uint8_t*)(ptr))
+#endif
+
+/* free list link of a free block, stored in header or (headerless) first word of data */
+#define BLK_LINK(blk) BLK_ENC(blk, *((uint8_t**)(blk)))
+#define BLK_SET_LINK(blk, next) (*((uint8_t**)(blk)) = BLK_ENC(blk, next))
+
+/* bitmap pools keep no free list, so their blocks have neither header nor link */
+#define BLK_BMP_POOL(heap, pool) ((heap)->blk_bmps != NULL && (heap)->blk_bmps[pool].sums != NULL)
+#define BLK_POOL_HDR(heap, pool) (BLK_BMP_POOL(heap, pool) ? 0 : BLK_HDR_SIZE)
+
+/* blk_pools entry for block sizes with no pool */
+#define POOL_NONE 0xFF
+
+#ifdef POOL_LOCKFREE
+/* tagged heads hold 32 bit heap offsets */
+#define POOL_HEAP_MAX UINT32_MAX
+#else
+#define POOL_HEAP_MAX SIZE_MAX
+#endif
+
+#ifdef POOL_CONCURRENT
+/* # of blocks moved between a thread cache and the shared pool free list at once */
+#ifndef POOL_MAG_BATCH
+#define POOL_MAG_BATCH 16
+#endif
+
+/* # of instances a thread can cache blocks for, other instances use the shared free list directly */
+#ifndef POOL_MAG_HEAPS
+#define POOL_MAG_HEAPS 4
+#endif
+
+/* per-thread magazine of free blocks for each pool of an instance, linked through block headers like blk_alloc */
+typedef struct {
+    pool_t* heap;              // instance cached blocks belong to, NULL if magazine unused
+    uint32_t heap_id;          // id of instance when magazine was claimed
+    uint8_t* blks[MAX_POOLS];  // first cached free block of each pool
+    uint16_t cnts[MAX_POOLS];  // # of cached free blocks of each pool
+    blk_stat_pend_t stats[MAX_POOLS]; // usage counts of each pool not yet folded into instance counters
+} blk_mag_t;
+
+/* all magazines of a thread */
+typedef struct {
+    blk_mag_t mags[POOL_MAG_HEAPS];
+    bool reg;                  // thread registered to flush magazines on exit
+} blk_mags_t;
+
+static pthread_key_t mag_key;     // runs mag_flush_all on thread exit
+static pthread_once_t mag_key_once = PTHREAD_ONCE_INIT;
+static __thread blk_mags_t tls_mags;
+#endif
+
+#ifdef POOL_THREADED
+/* counters shared between threads */
+#define POOL_STAT_ADD(ctr, val) __atomic_fetch_add(&(ctr), (val), __ATOMIC_RELAXED)
+#define POOL_STAT_LOAD(ctr) __atomic_load_n(&(ctr), __ATOMIC_RELAXED)
+#define POOL_STAT_STORE(ctr, val) __atomic_store_n(&(ctr), (val), __ATOMIC_RELAXED)
+#else
+#define POOL_STAT_ADD(ctr, val) ((ctr) += (val))
+#define POOL_STAT_LOAD(ctr) (ctr)
+#define POOL_STAT_STORE(ctr, val) ((ctr) = (val))
+#endif
+
+/* Description: verify instance is valid
+ * Args: heap - allocator instance
+ * Return: true if valid
+ */
+static bool heap_valid(const pool_t* heap);
+
+#ifdef POOL_TRACE
+/* Description: read tick counter, TSC on x86, monotonic ns elsewhere
+ * Args: none
+ * Return: current tick count
+ */
+static inline uint64_t trace_ticks(void);
+
+/* Description: count op that started at t0 in latency histogram
+ * Args: hist - histogram buckets
+ *       t0 - tick count at start of op
+ * Return: void
+ */
+static inline void trace_lat(uint64_t* hist, uint64_t t0);
+#endif
+
+/* Description: count alloc, free or failure of pool
+ * Args: heap - allocator instance
+ *       pool - pool index
+ *       stat - BLK_STAT_ALLOC, BLK_STAT_FREE or BLK_STAT_FAIL
+ * Return: void
+ */
+static inline void blk_stat(pool_t* heap, uint8_t pool, uint8_t stat);
+
+#ifdef POOL_THREADED
+/* Description: add pending counts to shared usage counters of pool and raise its high water mark
+ * Args: heap - allocator instance
+ *       pool - pool index
+ *       pend - pending counts, left unchanged
+ * Return: void
+ */
+static void blk_stat_add(pool_t* heap, uint8_t pool, const blk_stat_pend_t* pend);
+#endif
+
+/* Description: take a free block from pool
+ * Args: heap - allocator instance
+ *       pool - pool index
+ * Return: block header ptr, NULL if pool exhausted
+ */
+static uint8_t* blk_pop(pool_t* heap, uint8_t pool);
+
+/* Description: return a free block to pool
+ * Args: heap - allocator instance
+ *       pool - pool index
+ *       blk - block header ptr
+ * Return: void
+ */
+static void blk_push(pool_t* heap, uint8_t pool, uint8_t* blk);
+
+/* Description: splice chain of free blocks onto front of pool free list
+ * Args: heap - allocator instance
+ *       pool - pool index
+ *       head - first block of chain
+ *       tail - last block of chain
+ * Return: void
+ */
+static void blk_attach(pool_t* heap, uint8_t pool, uint8_t* head, uint8_t* tail);
+
+/* Description: detach chain of up to cnt blocks from front of pool free list
+ * Args: heap - allocator instance
+ *       pool - pool index
+ *       cnt - max # of blocks, updated with # of blocks detached
+ * Return: first block of detached chain, NULL terminated, NULL if pool exhausted
+ */
+static uint8_t* blk_detach(pool_t* heap, uint8_t pool, uint32_t* cnt);
+
+/* Description: drop every block from pool free list, blocks are carved again afterwards
+ * Args: heap - allocator instance
+ *       pool - pool index
+ * Return: void
+ */
+static void blk_empty(pool_t* heap, uint8_t pool);
+
+/* Description: take next block never handed out since init or reset from pool
+ * Args: heap - allocator instance
+ *       pool - pool index
+ * Return: block header ptr, free in bitmap, NULL if every block of pool is carved
+ */
+static uint8_t* blk_carve(pool_t* heap, uint8_t pool);
+
+/* Description: take a free block from free list or bitmap of pool
+ * Args: heap - allocator instance
+ *       pool - pool index
+ * Return: block header ptr, NULL if pool exhausted
+ */
+static inline uint8_t* blk_get(pool_t* heap, uint8_t pool);
+
+/* Description: take up to count free blocks from pool at once
+ * Args: heap - allocator instance
+ *       pool - pool index
+ *       blks - block header ptrs written here
+ *       count - max # of blocks
+ * Return: # of blocks taken
+ */
+static size_t blk_pop_batch(pool_t* heap, uint8_t pool, void** blks, size_t count);
+
+/* Description: mark block allocated in pool bitmap
+ * Args: map - pool bitmap
+ *       blk - block index
+ * Return: void
+ */
+static inline void blk_map_set(uint64_t* map, uint32_t blk);
+
+/* Description: mark block free in pool bitmap
+ * Args: map - pool bitmap
+ *       blk - block index
+ * Return: true if block was allocated, false if already free
+ */
+static inline bool blk_map_clear(uint64_t* map, uint32_t blk);
+
+/* Description: check block state in pool bitmap
+ * Args: map - pool bitmap
+ *       blk - block index
+ * Return: true if block allocated
+ */
+static inline bool blk_map_test(const uint64_t* map, uint32_t blk);
+
+/* Description: read a bitmap word
+ * Args: word - bitmap word
+ * Return: word value
+ */
+static inline uint64_t blk_map_load(const uint64_t* word);
+
+/* Description: mark blocks allocated in a bitmap word
+ * Args: word - bitmap word
+ *       mask - bits of blocks to mark
+ * Return: word value before marking, bits of mask already set there were claimed by another thread
+ */
+static inline uint64_t blk_map_claim(uint64_t* word, uint64_t mask);
+
+#ifdef POOL_CONCURRENT
+static void mag_key_create(void);
+static blk_mag_t* mag_get(pool_t* heap);
+#endif
+
+#ifdef POOL_LOCALITY
+/* Description: set up page free lists of pool, all empty until blocks are carved and freed
+ * Args: heap - allocator instance
+ *       pool - pool index
+ * Return: void
+ */
+static void blk_pages_init(pool_t* heap, uint8_t pool);
+
+/* Description: find lowest page with free blocks at or above page
+ * Args: pages - page free lists of pool
+ *       page - page index
+ * Return: page index, page_cnt if none
+ */
+static uint32_t blk_page_next(const blk_pages_t* pages, uint32_t page);
+
+#ifdef POOL_PARANOID
+/* Description: first block of free list that holds blk when free
+ * Args: heap - allocator instance
+ *       pool - pool index
+ *       blk - block header ptr
+ * Return: first block of page free list, or of slab free list for slab blocks
+ */
+static uint8_t* blk_list_head(pool_t* heap, uint8_t pool, const uint8_t* blk);
+#endif
+#endif
+
+#ifdef POOL_LOCKFREE
+/* Description: read first free block of pool from tagged head
+ * Args: heap - allocator instance
+ *       pool - pool index
+ * Return: block header ptr, NULL if pool exhausted
+ */
+static uint8_t* blk_head_load(pool_t* heap, uint8_t pool);
+#endif
+
+/* Description: block data alignment of pool per config
+ * Args: cfg - pool config
+ *       pool - pool index
+ * Return: alignment, at least BLK_ALIGN_MIN for free list pools, 1 for bitmap pools
+ */
+static size_t cfg_align(const pool_cfg_t* cfg, uint8_t pool);
+
+/* Description: check if pool is a bitmap pool per config
+ * Args: cfg - pool config
+ *       pool - pool index
+ * Return: true if bitmap pool
+ */
+static bool cfg_bitmap(const pool_cfg_t* cfg, uint8_t pool);
+
+/* Description: init summary bitmap of bitmap pool, bits past last block marked allocated so searches skip them
+ * Args: heap - allocator instance
+ *       pool - pool index
+ * Return: void
+ */
+static void blk_bmp_init(pool_t* heap, uint8_t pool);
+
+/* Description: find first allocation bitmap word at or after word that is not full
+ * Args: sums - summary bitmap
+ *       words - # of allocation bitmap words
+ *       word - word index to start at
+ * Return: word index, words if every word is full
+ */
+static size_t blk_bmp_next(const uint64_t* sums, size_t words, size_t word);
+
+/* Description: mark allocation bitmap word full in summary, unless a block of it was freed meanwhile
+ * Args: bmp - bitmap search of pool
+ *       map - allocation bitmap
+ *       word - word index
+ * Return: void
+ */
+static void blk_bmp_full(blk_bmp_t* bmp, uint64_t* map, size_t word);
+
+/* Description: claim up to count free blocks of bitmap pool, lowest addresses first
+ * Args: heap - allocator instance
+ *       pool - pool index
+ *       blks - block ptrs written here
+ *       count - max # of blocks
+ * Return: # of blocks claimed, marked allocated in bitmap
+ */
+static size_t blk_bmp_take(pool_t* heap, uint8_t pool, void** blks, size_t count);
+
+/* Description: make block of bitmap pool findable again after its bitmap bit was cleared
+ * Args: heap - allocator instance
+ *       pool - pool index
+ *       blk - block ptr
+ * Return: void
+ */
+static void blk_bmp_free(pool_t* heap, uint8_t pool, uint8_t* blk);
+
+/* Description: take a block from pool, growing it or falling back to larger pools when exhausted
+ * Args: heap - allocator instance
+ *       pool - pool index
+ *       n - requested size
+ *       align - required alignment, fallback pools must guarantee it
+ * Return: block data ptr, NULL if no block available
+ */
+static void* blk_take(pool_t* heap, uint8_t pool, size_t n, size_t align);
+
+/* Description: mark block taken from pool allocated and record it in counters
+ * Args: heap - allocator instance
+ *       pool - pool index block was taken from
+ *       pool_req - pool index selected for request
+ *       blk - block header ptr
+ *       n - requested size
+ * Return: block data ptr
+ */
+static void* blk_mark(pool_t* heap, uint8_t pool, uint8_t pool_req, uint8_t* blk, size_t n);
+
+#ifdef BLK_GUARDED
+/* Description: fill and poison data of a block becoming free, the link of headerless blocks stays accessible
+ * Args: heap - allocator instance
+ *       pool - pool index
+ *       blk - block header ptr
+ * Return: void
+ */
+static void blk_guard_free(pool_t* heap, uint8_t pool, uint8_t* blk);
+
+/* Description: unpoison data of a block being allocated and check its fill, bytes past n stay poisoned
+ * Args: heap - allocator instance
+ *       pool - pool index
+ *       data - block data ptr
+ *       n - requested size
+ * Return: true if data was not written while block was free
+ */
+static bool blk_guard_alloc(pool_t* heap, uint8_t pool, uint8_t* data, size_t n);
+#endif
+
+#if defined(POOL_CANARY) || defined(POOL_ENCODE)
+/* Description: make random key of canaries and link masks
+ * Args: void
+ * Return: non-zero key
+ */
+static uint64_t blk_key_new(void);
+#endif
+
+/* Description: verify ptr is an allocated block of instance and mark it free
+ * Args: heap - allocator instance
+ *       ptr - block data ptr
+ *       pool_out - pool index of block written here
+ *       slab_out - slab of block written here, NULL if block is in main heap
+ * Return: block header ptr, NULL if ptr is invalid or already free
+ */
+static uint8_t* blk_unmark(pool_t* heap, void* ptr, uint8_t* pool_out, pool_slab_t** slab_out);
+
+/* Description: account for block returned to free list of pool, releasing its slab once empty
+ * Args: heap - allocator instance
+ *       pool - pool index
+ *       slab - slab of block, NULL if block is in main heap
+ * Return: void
+ */
+static void blk_freed(pool_t* heap, uint8_t pool, pool_slab_t* slab);
+
+/* Description: free every block of pool, see pool_reset_from
+ * Args: heap - allocator instance
+ *       pool - pool index
+ * Return: void
+ */
+static void blk_reset(pool_t* heap, uint8_t pool);
+
+#ifdef POOL_CHECKPOINTS
+/* Description: close every open checkpoint, returning free blocks set aside by them to their pools
+ * Args: heap - allocator instance
+ * Return: void
+ */
+static void ckpt_drop(pool_t* heap);
+#endif
+
+/* Description: split bytes between pools per config - explicit block counts first, rest by weight
+ * Args: heap - allocator instance, blk_szs set
+ *       cfg - pool config
+ *       bytes - bytes available for pools
+ *       pool_sizes - bytes of each pool written here
+ * Return: true on success, false if explicit block counts do not fit
+ */
+static bool pool_split(const pool_t* heap, const pool_cfg_t* cfg, size_t bytes, size_t* pool_sizes);
+
+/* Description: find pool containing address
+ * Args: heap - allocator instance
+ *       ptr - address within pool region, must be >= pool_base_addrs[0]
+ * Return: pool index
+ */
+static uint8_t pool_find(const pool_t* heap, const uint8_t* ptr);
+
+/* Description: map memory aligned to align
+ * Args: len - bytes to map
+ *       align - alignment, power of 2
+ * Return: mapped memory, NULL on failure
+ */
+static void* map_aligned(size_t len, size_t align);
+
+/* Description: # of blocks of pool that fit in a slab after its header and bitmap
+ * Args: slab_size - bytes per slab
+ *       blk_mem_req - mem requirement of each block of pool
+ *       blk_align - block data alignment of pool, <= slab_size
+ *       blk_off - offset of first block from slab start written here
+ * Return: # of blocks
+ */
+static size_t slab_blks(size_t slab_size, size_t blk_mem_req, size_t blk_align, size_t* blk_off);
+
+/* Description: grow exhausted pool by a slab from the provider
+ * Args: heap - allocator instance with slab provider
+ *       pool - pool index
+ * Return: block header ptr taken from new slab, NULL if pool cannot grow
+ */
+static uint8_t* pool_grow(pool_t* heap, uint8_t pool);
+
+/* Description: mark every block of slab free and thread blocks from first on onto pool free list
+ * Args: heap - allocator instance
+ *       slab - slab
+ *       first - index of first block to thread, blocks before it are left to caller
+ * Return: void
+ */
+static void slab_thread(pool_t* heap, pool_slab_t* slab, uint32_t first);
+
+/* Description: find slab containing address
+ * Args: heap - allocator instance
+ *       ptr - address outside main heap
+ * Return: slab, NULL if ptr is not within a slab of instance
+ */
+static pool_slab_t* slab_find(pool_t* heap, const uint8_t* ptr);
+
+/* Description: find allocation bitmap and index of a block known to belong to pool
+ * Args: heap - allocator instance
+ *       pool - pool index
+ *       blk - block header ptr
+ *       slab - slab of block written here, NULL if block is in main heap
+ * Return: block index
+ */
+static inline uint32_t blk_locate(const pool_t* heap, uint8_t pool, uint8_t* blk, pool_slab_t** slab);
+
+#ifndef POOL_THREADED
+/* Description: remove empty slab from pool free list and registry and return it to provider
+ * Args: heap - allocator instance
+ *       slab - slab without allocated blocks
+ * Return: void
+ */
+static void slab_release(pool_t* heap, pool_slab_t* slab);
+#endif
+
+pool_t* pool_create(void* mem, size_t len, const size_t* block_sizes, size_t block_size_count)
+{
+    pool_cfg_t cfg = { .block_sizes = block_sizes, .block_size_count = block_size_count };
+    return pool_create_cfg(mem, len, &cfg);
+}
+
+pool_t* pool_create_cfg(void* mem, size_t len, const pool_cfg_t* cfg)
+{
+    /******* verify args *******/
+
+    /* verify valid config */
+    if (cfg == NULL) {
+#ifdef VERBOSE
+        printf("ERROR: invalid config\n");
+#endif
+        return NULL;
+    }
+
+    const size_t* block_sizes = cfg->block_sizes;
+    size_t block_size_count = cfg->block_size_count;
+
+    /* verify valid memory */
+    if (mem == NULL) {
+#ifdef VERBOSE
+        printf("ERROR: invalid heap memory\n");
+#endif
+        return NULL;
+    }
+
+#if defined(POOL_CANARY) || defined(POOL_ENCODE)
+    /* one key per process, set once so blocks of every instance keep decoding */
+    uint64_t key_unset = 0;
+    if (__atomic_load_n(&g_blk_key, __ATOMIC_RELAXED) == 0) {
+        __atomic_compare_exchange_n(&g_blk_key, &key_unset, blk_key_new(), false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    }
+#endif
+#ifdef BLK_ANNOTATE
+    /* memory may still be poisoned by an instance that was not destroyed */
+    BLK_ACCESS(mem, len);
+#endif
+
+    /* align start of heap so instance and heap mgmt data are naturally aligned */
+    uint8_t* heap_min = (uint8_t*)mem + (CACHE_LINE - ((uintptr_t)mem % CACHE_LINE)) % CACHE_LINE;
+    uint8_t* heap_max = (uint8_t*)mem + len;
+
+    /* verify heap large enough for instance and small enough to address */
+    if (heap_max < heap_min + sizeof(pool_t) || (size_t)(heap_max - heap_min) > POOL_HEAP_MAX) {
+#ifdef VERBOSE
+        printf("ERROR: invalid heap size\n");
+#endif
+        return NULL;
+    }
+
+    /* verify valid number of pools */
+    if (block_size_count < MIN_POOLS || block_size_count > MAX_POOLS) {
+#ifdef VERBOSE
+        printf("ERROR: invalid number of pools\n");
+#endif
+        return NULL;
+    }
+
+    /* verify valid block sizes array */
+    if (block_sizes == NULL) {
+#ifdef VERBOSE
+        printf("ERROR: invalid block_size array\n");
+#endif
+        return NULL;
+    }
+
+    /* verify valid block sizes */
+    for (uint8_t i = 0; i < block_size_count; i++) {
+        if (block_sizes[i] < MIN_BLOCK_SIZE || block_sizes[i] > MAX_BLOCK_SIZE) {
+#ifdef VERBOSE
+            printf("ERROR: invalid block size\n");
+#endif
+            return NULL;
+        }
+    }
+
+    /* verify valid alignments */
+    for (uint8_t i = 0; cfg->alignments != NULL && i < block_size_count; i++) {
+        size_t align = cfg->alignments[i];
+        if ((align & (align - 1)) != 0 || align > MAX_BLOCK_ALIGN) {
+#ifdef VERBOSE
+            printf("ERROR: invalid block alignment\n");
+#endif
+            return NULL;
+        }
+    }
+
+    /* bitmap pools are not threaded onto a free list, so they cannot take slab blocks */
+    for (uint8_t i = 0; cfg->bitmaps != NULL && i < block_size_count; i++) {
+        if (cfg->bitmaps[i] && cfg->slab_alloc != NULL) {
+#ifdef VERBOSE
+            printf("ERROR: bitmap pools cannot grow\n");
+#endif
+            return NULL;
+        }
+    }
+
+    /* verify every pool gets a share of the heap, either a block count or a weight */
+    for (uint8_t i = 0; i < block_size_count; i++) {
+        bool counted = cfg->block_counts != NULL && cfg->block_counts[i] > 0;
+        bool weighted = cfg->weights == NULL || cfg->weights[i] > 0;
+        if (!counted && !weighted) {
+#ifdef VERBOSE
+            printf("ERROR: pool without block count or weight\n");
+#endif
+            return NULL;
+        }
+    }
+
+    /* verify growth config - power of 2 slabs so a block finds its slab by masking, each holding a block of every pool */
+    size_t slab_size = (cfg->slab_size == 0) ? POOL_SLAB_SIZE : cfg->slab_size;
+    size_t slab_max = (cfg->slab_max == 0) ? POOL_SLAB_MAX : cfg->slab_max;
+    if (cfg->slab_alloc != NULL) {
+#ifdef POOL_LOCKFREE
+        /* note: tagged heads hold heap offsets, which cannot address slabs */
+#ifdef VERBOSE
+        printf("ERROR: pool growth not supported with POOL_LOCKFREE\n");
+#endif
+        return NULL;
+#endif
+        bool slab_valid = (slab_size & (slab_size - 1)) == 0;
+        for (uint8_t i = 0; i < block_size_count && slab_valid; i++) {
+            size_t blk_off;
+            size_t align = cfg_align(cfg, i);
+            size_t blks = slab_blks(slab_size, BLK_MEM_REQ(block_sizes[i] + BLK_CANARY_SIZE, BLK_HDR_SIZE, align), align, &blk_off);
+            slab_valid = align <= slab_size && blks > 0 && blks <= UINT32_MAX;
+        }
+        if (!slab_valid) {
+#ifdef VERBOSE
+            printf("ERROR: invalid slab size\n");
+#endif
+            return NULL;
+        }
+
+#ifdef POOL_THREADED
+        /* note: free blocks of a slab may sit in other threads' caches, so an empty slab cannot be unlinked */
+        if (cfg->slab_release > 0) {
+#ifdef VERBOSE
+            printf("ERROR: slab release not supported with POOL_CONCURRENT\n");
+#endif
+            return NULL;
+        }
+#endif
+    }
+
+    /******* init heap management data *******/
+
+    /* instance at beginning of heap */
+    uint8_t* brk = heap_min;
+    pool_t* heap = (pool_t*)brk;
+    brk += sizeof(pool_t);
+
+    heap->magic = 0;
+    heap->heap = heap_min;
+    heap->heap_max = heap_max;
+    heap->blk_sz_cnt = block_size_count;
+
+    heap->slab_alloc = cfg->slab_alloc;
+    heap->slab_free = cfg->slab_free;
+    heap->slab_ctx = cfg->slab_ctx;
+    heap->slab_size = slab_size;
+    heap->slab_max = slab_max;
+    heap->slab_release = (cfg->slab_free != NULL) ? cfg->slab_release : 0;
+    heap->slab_cnt = 0;
+    heap->slabs = NULL;
+    heap->blk_avail = NULL;
+#ifdef POOL_CHECKPOINTS
+    heap->ckpt = NULL;
+#endif
+#ifdef POOL_TRACE
+    heap->blk_lats = NULL;
+    heap->trace = NULL;
+    heap->trace_ctx = NULL;
+#endif
+
+    /* write block sizes after instance */
+    heap->blk_szs = (uint16_t*)brk;
+
+    for (uint8_t i = 0; i < heap->blk_sz_cnt; i++) {
+        *((uint16_t*)brk) = (uint16_t)(block_sizes[i]);
+        brk += sizeof(uint16_t);
+    }
+
+    /* write block alignments and block mem requirements after block sizes */
+    heap->blk_aligns = (uint16_t*)brk;
+    brk += heap->blk_sz_cnt * sizeof(uint16_t);
+    heap->blk_mem_reqs = (uint16_t*)brk;
+    brk += heap->blk_sz_cnt * sizeof(uint16_t);
+
+    for (uint8_t i = 0; i < heap->blk_sz_cnt; i++) {
+        heap->blk_aligns[i] = cfg_align(cfg, i);
+        /* note: bitmap pools stay dense, without header or canary */
+        bool bmp = cfg_bitmap(cfg, i);
+        heap->blk_mem_reqs[i] = BLK_MEM_REQ(heap->blk_szs[i] + (bmp ? 0 : BLK_CANARY_SIZE), bmp ? 0 : BLK_HDR_SIZE, heap->blk_aligns[i]);
+    }
+
+    /* reserve space for size to pool lookup table and fill it */
+    /* note: first pool wins if a block size is listed twice */
+    heap->blk_pools = brk;
+    brk += (MAX_BLOCK_SIZE + 1) * sizeof(uint8_t);
+
+    for (uint16_t i = 0; i <= MAX_BLOCK_SIZE; i++) {
+        heap->blk_pools[i] = POOL_NONE;
+    }
+    for (uint8_t i = heap->blk_sz_cnt; i > 0; i--) {
+        heap->blk_pools[heap->blk_szs[i-1]] = i - 1;
+    }
+
+#ifdef POOL_BEST_FIT
+    /* fill gaps so each size maps to smallest pool with block size >= size */
+    for (uint16_t i = MAX_BLOCK_SIZE; i > MIN_BLOCK_SIZE; i--) {
+        if (heap->blk_pools[i-1] == POOL_NONE) {
+            heap->blk_pools[i-1] = heap->blk_pools[i];
+        }
+    }
+
+    /* reserve space for next larger pool of each pool, used when a pool is exhausted */
+    heap->blk_next = brk;
+    brk += heap->blk_sz_cnt * sizeof(uint8_t);
+
+    for (uint8_t i = 0; i < heap->blk_sz_cnt; i++) {
+        heap->blk_next[i] = (heap->blk_szs[i] < MAX_BLOCK_SIZE) ? heap->blk_pools[heap->blk_szs[i] + 1] : POOL_NONE;
+    }
+#endif
+
+    /* align brk so pointer arrays are naturally aligned */
+    brk += (sizeof(uint8_t*) - ((uintptr_t)brk % sizeof(uint8_t*))) % sizeof(uint8_t*);
+
+    /* reserve space for pool base address pointers */
+    heap->pool_base_addrs = (uint8_t**)brk;
+    brk += heap->blk_sz_cnt * sizeof(uint8_t*);
+
+    /* reserve space for pool next block allocation address pointers */
+    heap->blk_alloc = (blk_head_t*)brk;
+    brk += heap->blk_sz_cnt * sizeof(blk_head_t);
+
+    /* reserve space for pool allocation bitmap pointers */
+    heap->blk_maps = (uint64_t**)brk;
+    brk += heap->blk_sz_cnt * sizeof(uint64_t*);
+
+    /* reserve space for slab registry of growable instance */
+    if (heap->slab_alloc != NULL) {
+        if (brk > heap_max || heap->slab_max > (size_t)(heap_max - brk) / sizeof(pool_slab_t*)) {
+#ifdef VERBOSE
+            printf("ERROR: heap too small\n");
+#endif
+            return NULL;
+        }
+        heap->slabs = (pool_slab_t**)brk;
+        brk += heap->slab_max * sizeof(pool_slab_t*);
+    }
+
+    /* reserve space for free block counts, the watermark of slab release */
+    if (heap->slab_alloc != NULL && heap->slab_release > 0) {
+        heap->blk_avail = (size_t*)brk;
+        brk += heap->blk_sz_cnt * sizeof(size_t);
+    }
+
+    /* reserve space for pool block counts */
+    heap->blk_cnts = (uint32_t*)brk;
+    brk += heap->blk_sz_cnt * sizeof(uint32_t);
+
+#ifndef POOL_CONCURRENT
+    /* reserve space for carved block counts, kept with the pool locks otherwise */
+    heap->blk_carved = (uint32_t*)brk;
+    brk += heap->blk_sz_cnt * sizeof(uint32_t);
+#endif
+
+    /* align brk so bitmap words are naturally aligned */
+    brk += (sizeof(uint64_t) - ((uintptr_t)brk % sizeof(uint64_t))) % sizeof(uint64_t);
+
+    /* reserve space for usage counters */
+    heap->blk_stats = (blk_stat_t*)brk;
+    brk += heap->blk_sz_cnt * sizeof(blk_stat_t);
+
+    /* reserve space for bitmap search, summary bitmaps follow the allocation bitmaps */
+    heap->blk_bmps = NULL;
+    if (cfg->bitmaps != NULL) {
+        heap->blk_bmps = (blk_bmp_t*)brk;
+        brk += heap->blk_sz_cnt * sizeof(blk_bmp_t);
+    }
+
+#ifdef POOL_LOCALITY
+    /* reserve space for page free lists, heads and maps follow the allocation bitmaps */
+    heap->blk_pages = (blk_pages_t*)brk;
+    brk += heap->blk_sz_cnt * sizeof(blk_pages_t);
+#endif
+
+#ifdef POOL_BEST_FIT
+    /* reserve space for fragmentation counters */
+    heap->blk_frags = (pool_frag_t*)brk;
+    brk += heap->blk_sz_cnt * sizeof(pool_frag_t);
+
+    for (uint8_t i = 0; i < heap->blk_sz_cnt; i++) {
+        heap->blk_frags[i] = (pool_frag_t){ 0 };
+    }
+#endif
+
+#ifdef POOL_CONCURRENT
+    /* reserve space for pool locks on their own cache lines */
+    brk += (CACHE_LINE - ((uintptr_t)brk % CACHE_LINE)) % CACHE_LINE;
+    heap->pool_locks = (pool_lock_t*)brk;
+    brk += heap->blk_sz_cnt * sizeof(pool_lock_t);
+    heap->blk_remotes = (pool_remote_t*)brk;
+    brk += heap->blk_sz_cnt * sizeof(pool_remote_t);
+#endif
+
+    /* split bytes after fixed heap mgmt data between pools, ignoring bitmaps */
+    /* note: bitmaps sized from this split are an upper bound since pools only shrink once bitmaps are reserved */
+    size_t pool_sizes[MAX_POOLS];
+    if (brk > heap_max || !pool_split(heap, cfg, heap_max - brk, pool_sizes)) {
+#ifdef VERBOSE
+        printf("ERROR: heap too small\n");
+#endif
+        return NULL;
+    }
+
+    for (uint8_t i = 0; i < heap->blk_sz_cnt; i++) {
+        heap->blk_stats[i] = (blk_stat_t){ 0 };
+    }
+
+    /* reserve allocation bitmaps */
+    for (uint8_t i = 0; i < heap->blk_sz_cnt; i++) {
+        size_t max_blks = pool_sizes[i] / heap->blk_mem_reqs[i];
+        if ((size_t)(heap_max - brk) < BLK_MAP_WORDS(max_blks) * sizeof(uint64_t)) {
+#ifdef VERBOSE
+            printf("ERROR: heap too small\n");
+#endif
+            return NULL;
+        }
+
+        heap->blk_maps[i] = (uint64_t*)brk;
+        for (size_t j = 0; j < BLK_MAP_WORDS(max_blks); j++) {
+            heap->blk_maps[i][j] = 0;
+        }
+        brk += BLK_MAP_WORDS(max_blks) * sizeof(uint64_t);
+    }
+
+    /* reserve summary bitmaps, one bit per allocation bitmap word */
+    for (uint8_t i = 0; heap->blk_bmps != NULL && i < heap->blk_sz_cnt; i++) {
+        heap->blk_bmps[i].sums = NULL;
+        if (!cfg->bitmaps[i]) {
+            continue;
+        }
+
+        size_t max_words = BLK_MAP_WORDS(pool_sizes[i] / heap->blk_mem_reqs[i]);
+        if ((size_t)(heap_max - brk) < BLK_MAP_WORDS(max_words) * sizeof(uint64_t)) {
+#ifdef VERBOSE
+            printf("ERROR: heap too small\n");
+#endif
+            return NULL;
+        }
+        heap->blk_bmps[i].sums = (uint64_t*)brk;
+        brk += BLK_MAP_WORDS(max_words) * sizeof(uint64_t);
+    }
+
+#ifdef POOL_LOCALITY
+    /* reserve page heads and maps, blocks of a pool span at most its size in pages plus partial first and last page */
+    for (uint8_t i = 0; i < heap->blk_sz_cnt; i++) {
+        if (cfg_bitmap(cfg, i)) {
+            continue;
+        }
+        size_t max_pages = pool_sizes[i] / POOL_PAGE_SIZE + 2;
+        size_t pages_size = max_pages * sizeof(uint8_t*) + BLK_MAP_WORDS(max_pages) * sizeof(uint64_t);
+        if ((size_t)(heap_max - brk) < pages_size) {
+#ifdef VERBOSE
+            printf("ERROR: heap too small\n");
+#endif
+            return NULL;
+        }
+
+        heap->blk_pages[i].map = (uint64_t*)brk;
+        brk += BLK_MAP_WORDS(max_pages) * sizeof(uint64_t);
+        heap->blk_pages[i].heads = (uint8_t**)brk;
+        brk += max_pages * sizeof(uint8_t*);
+    }
+#endif
+
+    /* compute bytes available after reserving heap memory management and split again to find pool sizes */
+    size_t heap_size = heap_max - heap_min;
+    size_t heap_mgmt_size = brk - heap_min;
+    size_t bytes_free = heap_size - heap_mgmt_size;
+    if (!pool_split(heap, cfg, bytes_free, pool_sizes)) {
+#ifdef VERBOSE
+        printf("ERROR: heap too small\n");
+#endif
+        return NULL;
+    }
+
+    size_t pools_size = 0;
+    for (uint8_t i = 0; i < heap->blk_sz_cnt; i++) {
+        pools_size += pool_sizes[i];
+    }
+    size_t heap_remainder = bytes_free - pools_size;
+
+    /* verify heap mgmnt + size of all pools + remainder (if any) == total heap size */
+    assert(heap_size == (heap_mgmt_size + pools_size + heap_remainder));
+
+    /* compute and assign pool_base_addrs - first block of each pool share with aligned block data */
+    /* note: on first itr, brk is after end of heap mgmt data which is start of pool[0] share */
+    /* note: padding before first block is slack of the previous pool (heap mgmt data for pool[0]) */
+    size_t pool_blks[MAX_POOLS];
+    uint8_t* pool_min = brk;
+    for (uint8_t i = 0; i < heap->blk_sz_cnt; i++) {
+        size_t blk_off = BLK_ALIGN_OFF(pool_min, BLK_POOL_HDR(heap, i), heap->blk_aligns[i]);
+        heap->pool_base_addrs[i] = pool_min + blk_off;
+        pool_blks[i] = (pool_sizes[i] < blk_off) ? 0 : (pool_sizes[i] - blk_off) / heap->blk_mem_reqs[i];
+        pool_min += pool_sizes[i];
+    }
+    heap->pool_max = pool_min;
+
+    /* verify every pool has at least one block, and no more than a 32 bit block index can address */
+    for (uint8_t i = 0; i < heap->blk_sz_cnt; i++) {
+        if (pool_blks[i] == 0) {
+#ifdef VERBOSE
+            printf("ERROR: heap too small\n");
+#endif
+            return NULL;
+        }
+        if (pool_blks[i] > UINT32_MAX) {
+#ifdef VERBOSE
+            printf("ERROR: too many blocks in pool\n");
+#endif
+            return NULL;
+        }
+    }
+
+#ifdef VERBOSE
+    printf("-- HEAP --\n");
+    printf("full heap size: %zu bytes\n", heap_size);
+    printf("heap mgmt size: %zu bytes\n", heap_mgmt_size);
+    printf("heap pool size: %zu bytes\n", pools_size);
+    printf("heap remainder: %zu bytes\n", heap_remainder);
+#endif
+
+    /******* create pools *******/
+
+    /* pools start with an empty free list, blocks are carved from pool_base_addr[i] up on first use */
+    /* note: no block is written here, so pages of blocks never allocated are never touched */
+    for (uint8_t i = 0; i < heap->blk_sz_cnt; i++) {
+        size_t blk_mem_req = heap->blk_mem_reqs[i];
+        size_t bytes_padding = heap->pool_base_addrs[i] - brk;
+        size_t bytes_remainder = pool_sizes[i] - bytes_padding - blk_mem_req * pool_blks[i];
+
+        /* verify padding + number of blocks * block memory + remainder bytes == pool size */
+        assert(pool_sizes[i] == (bytes_padding + blk_mem_req * pool_blks[i] + bytes_remainder));
+
+        heap->blk_cnts[i] = pool_blks[i];
+        BLK_CARVED(heap, i) = 0;
+        heap->blk_alloc[i] = BLK_HEAD_PACK(heap, 0, NULL);
+        if (heap->blk_avail != NULL) {
+            heap->blk_avail[i] = pool_blks[i];
+        }
+
+#ifdef VERBOSE
+        printf("\n-- POOL[%d] --\n", i);
+        printf("blk_szs[%d]:  %d\n", i, heap->blk_szs[i]);
+        printf("blk_align:   %d\n", heap->blk_aligns[i]);
+        printf("pool_size:   %zu\n", pool_sizes[i]);
+        printf("blk_mem_req: %zu\n", blk_mem_req);
+        printf("pool_blks:   %zu\n", pool_blks[i]);
+        printf("bytes_pad:   %zu\n", bytes_padding);
+        printf("bytes_rmdr:  %zu\n", bytes_remainder);
+#endif
+
+        /* skip alignment padding */
+        brk = heap->pool_base_addrs[i];
+
+        /* bitmap pool is searched, not carved, every block is free in its zeroed bitmap */
+        if (BLK_BMP_POOL(heap, i)) {
+            BLK_CARVED(heap, i) = pool_blks[i];
+#ifdef BLK_GUARDED
+            for (size_t j = 0; j < pool_blks[i]; j++) {
+                blk_guard_free(heap, i, brk + j * blk_mem_req);
+            }
+#endif
+            blk_bmp_init(heap, i);
+        }
+        else {
+#ifdef BLK_ANNOTATE
+            /* blocks not carved yet are off limits, carving opens and guards each one */
+            BLK_NOACCESS(brk, blk_mem_req * pool_blks[i]);
+#endif
+#ifdef POOL_LOCALITY
+            blk_pages_init(heap, i);
+#endif
+        }
+
+        /* add block and remaining bytes to get to start of next pool share */
+        brk += blk_mem_req * pool_blks[i] + bytes_remainder;
+    }
+
+    /* no byte left behind */
+    assert((brk + heap_remainder) == heap_max);
+
+#ifdef POOL_CONCURRENT
+    for (uint8_t i = 0; i < heap->blk_sz_cnt; i++) {
+        pthread_mutex_init(&heap->pool_locks[i].mtx, NULL);
+        heap->blk_remotes[i].head = NULL;
+    }
+    pthread_rwlock_init(&heap->slab_lock, NULL);
+
+    pthread_once(&mag_key_once, mag_key_create);
+#endif
+
+    /* heap init complete */
+    heap->id = POOL_STAT_ADD(g_pool_ids, 1);
+    heap->magic = POOL_MAGIC;
+
+    return heap;
+}
+
+void pool_destroy(pool_t* heap)
+{
+    /* verify pool already init */
+    if (!heap_valid(heap)) {
+#ifdef VERBOSE
+        printf("ERROR: pool not init\n");
+#endif
+        return;
+    }
+
+#ifdef POOL_CONCURRENT
+    for (uint8_t i = 0; i < heap->blk_sz_cnt; i++) {
+        pthread_mutex_destroy(&heap->pool_locks[i].mtx);
+    }
+    pthread_rwlock_destroy(&heap->slab_lock);
+#endif
+
+    /* return slabs to provider */
+    if (heap->slab_free != NULL) {
+        for (size_t i = 0; i < heap->slab_cnt; i++) {
+#ifdef BLK_ANNOTATE
+            BLK_ACCESS(heap->slabs[i], heap->slab_size);
+#endif
+            heap->slab_free(heap->slabs[i], heap->slab_size, heap->slab_ctx);
+        }
+    }
+    heap->slab_cnt = 0;
+
+    /* memory belongs to caller again */
+    heap->magic = 0;
+#ifdef BLK_ANNOTATE
+    BLK_ACCESS(heap, (size_t)(heap->heap_max - (uint8_t*)heap));
+#endif
+}
+
+void* pool_malloc_from(pool_t* heap, size_t n)
+{
+    /******* verify pool state and args *******/
+
+    /* verify pool already init */
+    if (!heap_valid(heap)) {
+#ifdef VERBOSE
+        printf("ERROR: pool not init\n");
+#endif
+        return NULL;
+    }
+
+    /* verify selected block size is valid and if so, find index */
+    if (n > MAX_BLOCK_SIZE || heap->blk_pools[n] == POOL_NONE) {
+#ifdef VERBOSE
+        printf("ERROR: invalid block size\n");
+#endif
+        return NULL;
+    }
+
+    return blk_take(heap, heap->blk_pools[n], n, 1);
+}
+
+void* pool_malloc_aligned_from(pool_t* heap, size_t n, size_t align)
+{
+    /******* verify pool state and args *******/
+
+    /* verify pool already init */
+    if (!heap_valid(heap)) {
+#ifdef VERBOSE
+        printf("ERROR: pool not init\n");
+#endif
+        return NULL;
+    }
+
+    /* verify selected block size is valid and if so, find index */
+    if (n > MAX_BLOCK_SIZE || heap->blk_pools[n] == POOL_NONE) {
+#ifdef VERBOSE
+        printf("ERROR: invalid block size\n");
+#endif
+        return NULL;
+    }
+
+    /* verify valid alignment */
+    if (align == 0 || (align & (align - 1)) != 0) {
+#ifdef VERBOSE
+        printf("ERROR: invalid block alignment\n");
+#endif
+        return NULL;
+    }
+
+    /* size table pool may not guarantee align, then use first pool of same block size that does */
+    /* note: with POOL_BEST_FIT, smallest pool that fits and guarantees align */
+    uint8_t pool = heap->blk_pools[n];
+    if (heap->blk_aligns[pool] < align) {
+        pool = POOL_NONE;
+        for (uint8_t i = 0; i < heap->blk_sz_cnt; i++) {
+#ifdef POOL_BEST_FIT
+            bool fits = heap->blk_szs[i] >= n && (pool == POOL_NONE || heap->blk_szs[i] < heap->blk_szs[pool]);
+#else
+            bool fits = heap->blk_szs[i] == n && pool == POOL_NONE;
+#endif
+            if (fits && heap->blk_aligns[i] >= align) {
+                pool = i;
+            }
+        }
+    }
+
+    if (pool == POOL_NONE) {
+#ifdef VERBOSE
+        printf("ERROR: no pool with block alignment\n");
+#endif
+        return NULL;
+    }
+
+    return blk_take(heap, pool, n, align);
+}
+
+static void* blk_take(pool_t* heap, uint8_t pool, size_t n, size_t align)
+{
+    uint8_t pool_req = pool;
+#ifdef POOL_TRACE
+    pool_lat_t* lats = heap->blk_lats;
+    uint64_t t0 = (lats != NULL) ? trace_ticks() : 0;
+#endif
+
+    /******* allocate block and identify next block to be allocated *******/
+
+    /* allocate free block */
+    uint8_t* blk = blk_get(heap, pool);
+
+    /* grow exhausted pool if instance has a slab provider */
+    if (blk == NULL && heap->slab_alloc != NULL) {
+        blk = pool_grow(heap, pool);
+    }
+
+#ifdef POOL_BEST_FIT
+    /* fall back to next larger pool while pool is exhausted, skipping pools without required alignment */
+    while (blk == NULL && heap->blk_next[pool] != POOL_NONE) {
+        pool = heap->blk_next[pool];
+        if (heap->blk_aligns[pool] >= align) {
+            blk = blk_get(heap, pool);
+        }
+    }
+#else
+    (void)align;
+#endif
+
+    /* check if pool has available blocks */
+    if (blk == NULL) {
+#ifdef VERBOSE
+        printf("ERROR: no block available\n");
+#endif
+        blk_stat(heap, pool_req, BLK_STAT_FAIL);
+#ifdef POOL_TRACE
+        if (lats != NULL) {
+            trace_lat(lats[pool_req].malloc_ticks, t0);
+        }
+        if (heap->trace != NULL) {
+            heap->trace(heap->trace_ctx, POOL_TRACE_EXHAUSTED, pool_req, NULL, n);
+        }
+#endif
+        return NULL;
+    }
+
+    void* ptr = blk_mark(heap, pool, pool_req, blk, n);
+#ifdef POOL_TRACE
+    if (lats != NULL) {
+        trace_lat(lats[pool].malloc_ticks, t0);
+    }
+    if (heap->trace != NULL) {
+        heap->trace(heap->trace_ctx, POOL_TRACE_ALLOC, pool, ptr, n);
+    }
+#endif
+    return ptr;
+}
+
+static void* blk_mark(pool_t* heap, uint8_t pool, uint8_t pool_req, uint8_t* blk, size_t n)
+{
+    /* mark block allocated */
+    pool_slab_t* slab;
+    uint32_t blk_idx = blk_locate(heap, pool, blk, &slab);
+    bool bmp = BLK_BMP_POOL(heap, pool);
+    if (!bmp) {
+        /* note: bitmap pools set the bit when claiming the block */
+        blk_map_set((slab == NULL) ? heap->blk_maps[pool] : slab->map, blk_idx);
+    }
+
+    blk_stat(heap, pool, BLK_STAT_ALLOC);
+
+#ifndef POOL_THREADED
+    if (slab != NULL) {
+        slab->blk_used++;
+    }
+    if (heap->blk_avail != NULL) {
+        heap->blk_avail[pool]--;
+    }
+#endif
+
+#ifdef POOL_BEST_FIT
+    /* record internal fragmentation */
+    POOL_STAT_ADD(heap->blk_frags[pool].allocs, 1);
+    POOL_STAT_ADD(heap->blk_frags[pool].fallbacks, (pool != pool_req));
+    POOL_STAT_ADD(heap->blk_frags[pool].req_bytes, n);
+    POOL_STAT_ADD(heap->blk_frags[pool].waste_bytes, heap->blk_szs[pool] - n);
+#else
+    (void)pool_req;
+#ifndef BLK_GUARDED
+    (void)n;
+#endif
+#endif
+
+    /* convert block header ptr to block data ptr */
+    uint8_t* data = bmp ? blk : blk_hdr_to_data(blk);
+#ifdef BLK_GUARDED
+    bool clean = blk_guard_alloc(heap, pool, data, n);
+#ifdef POOL_POISON
+    if (!clean) {
+#ifdef VERBOSE
+        printf("ERROR: block written after free\n");
+#endif
+        POOL_STAT_ADD(heap->blk_stats[pool].faults, 1);
+    }
+#else
+    (void)clean;
+#endif
+#endif
+#ifdef POOL_CANARY
+    if (!bmp) {
+        uint64_t canary = BLK_CANARY(data);
+        memcpy(data + heap->blk_szs[pool], &canary, sizeof(canary));
+    }
+#endif
+    return data;
+}
+
+#ifdef BLK_GUARDED
+/* link of headerless blocks lives in first word of data, kept accessible while free */
+#define BLK_GUARD_SKIP(bmp) ((bmp) ? 0 : sizeof(uint8_t*) - BLK_HDR_SIZE)
+
+static void blk_guard_free(pool_t* heap, uint8_t pool, uint8_t* blk)
+{
+    bool bmp = BLK_BMP_POOL(heap, pool);
+    size_t skip = BLK_GUARD_SKIP(bmp);
+    if (heap->blk_szs[pool] <= skip) {
+        return;
+    }
+    uint8_t* fill = (bmp ? blk : blk_hdr_to_data(blk)) + skip;
+    size_t len = heap->blk_szs[pool] - skip;
+
+#ifdef BLK_ANNOTATE
+    /* tail past the request is still poisoned, and so is all of it on a double free */
+    BLK_ACCESS(fill, len);
+#endif
+#ifdef POOL_POISON
+    memset(fill, BLK_POISON_BYTE, len);
+#endif
+#ifdef BLK_ANNOTATE
+    BLK_NOACCESS(fill, len);
+#endif
+}
+
+static bool blk_guard_alloc(pool_t* heap, uint8_t pool, uint8_t* data, size_t n)
+{
+    bool bmp = BLK_BMP_POOL(heap, pool);
+    size_t skip = BLK_GUARD_SKIP(bmp);
+    size_t blk_sz = heap->blk_szs[pool];
+    if (blk_sz <= skip) {
+        return true;
+    }
+    uint8_t* fill = data + skip;
+    size_t len = blk_sz - skip;
+
+#ifdef BLK_ANNOTATE
+    BLK_ACCESS(fill, len);
+#endif
+    /* no early exit, so the compare vectorizes */
+    uint8_t diff = 0;
+#ifdef POOL_POISON
+    for (size_t i = 0; i < len; i++) {
+        diff |= fill[i] ^ BLK_POISON_BYTE;
+    }
+#endif
+#ifdef BLK_ANNOTATE
+    /* caller gets n bytes of uninitialised memory, overflow into the rest of the block is reported */
+    BLK_UNDEFINED(data, n);
+    size_t end = (n > skip) ? n : skip;
+    if (end < blk_sz) {
+        BLK_NOACCESS(data + end, blk_sz - end);
+    }
+#else
+    (void)n;
+#endif
+    return diff == 0;
+}
+#endif
+
+#if defined(POOL_CANARY) || defined(POOL_ENCODE)
+static uint64_t blk_key_new(void)
+{
+    /* mix clock and addresses, randomized by ASLR, through the splitmix64 finalizer */
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t key = (uint64_t)ts.tv_nsec ^ ((uint64_t)ts.tv_sec << 32) ^ (uintptr_t)&ts ^ ((uint64_t)(uintptr_t)&g_blk_key << 16);
+    key ^= key >> 30;
+    key *= 0xBF58476D1CE4E5B9ULL;
+    key ^= key >> 27;
+    key *= 0x94D049BB133111EBULL;
+    key ^= key >> 31;
+    return (key != 0) ? key : 1;
+}
+#endif
+
+void pool_free_from(pool_t* heap, void* ptr)
+{
+    /******* verify pool state and args *******/
+
+    /* verify pool already init */
+    if (!heap_valid(heap)) {
+#ifdef VERBOSE
+        printf("ERROR: pool not init\n");
+#endif
+        return;
+    }
+#ifdef POOL_TRACE
+    pool_lat_t* lats = heap->blk_lats;
+    uint64_t t0 = (lats != NULL) ? trace_ticks() : 0;
+#endif
+
+    /* verify ptr and mark block free */
+    uint8_t pool;
+    pool_slab_t* slab;
+    uint8_t* hdr_ptr = blk_unmark(heap, ptr, &pool, &slab);
+    if (hdr_ptr == NULL) {
+        return;
+    }
+
+    /******* free block and add to front of block alloc list *******/
+
+    if (BLK_BMP_POOL(heap, pool)) {
+        blk_bmp_free(heap, pool, hdr_ptr);
+    }
+    else {
+        blk_push(heap, pool, hdr_ptr);
+    }
+    blk_freed(heap, pool, slab);
+
+#ifdef POOL_TRACE
+    if (lats != NULL) {
+        trace_lat(lats[pool].free_ticks, t0);
+    }
+    if (heap->trace != NULL) {
+        heap->trace(heap->trace_ctx, POOL_TRACE_FREE, pool, ptr, heap->blk_szs[pool]);
+    }
+#endif
+    return;
+}
+
+size_t pool_malloc_batch_from(pool_t* heap, size_t n, void** out, size_t count)
+{
+    /******* verify pool state and args once for the batch *******/
+
+    /* verify pool already init */
+    if (!heap_valid(heap)) {
+#ifdef VERBOSE
+        printf("ERROR: pool not init\n");
+#endif
+        return 0;
+    }
+
+    /* verify selected block size is valid and if so, find index */
+    if (n > MAX_BLOCK_SIZE || heap->blk_pools[n] == POOL_NONE) {
+#ifdef VERBOSE
+        printf("ERROR: invalid block size\n");
+#endif
+        return 0;
+    }
+
+    if (out == NULL) {
+#ifdef VERBOSE
+        printf("ERROR: invalid block array\n");
+#endif
+        return 0;
+    }
+
+    /* note: free list detach always takes the head, so an empty batch must not reach it */
+    if (count == 0) {
+        return 0;
+    }
+
+    uint8_t pool = heap->blk_pools[n];
+
+    /******* detach sub-chain of free list and mark its blocks allocated *******/
+
+    size_t got = BLK_BMP_POOL(heap, pool) ? blk_bmp_take(heap, pool, out, count) : blk_pop_batch(heap, pool, out, count);
+    for (size_t i = 0; i < got; i++) {
+        out[i] = blk_mark(heap, pool, pool, (uint8_t*)out[i], n);
+#ifdef POOL_TRACE
+        if (heap->trace != NULL) {
+            heap->trace(heap->trace_ctx, POOL_TRACE_ALLOC, pool, out[i], n);
+        }
+#endif
+    }
+
+    /* pool exhausted part way, grow or fall back one block at a time */
+    while (got < count && (out[got] = blk_take(heap, pool, n, 1)) != NULL) {
+        got++;
+    }
+    return got;
+}
+
+void pool_free_batch_from(pool_t* heap, void** ptrs, size_t count)
+{
+    /******* verify pool state and args once for the batch *******/
+
+    /* verify pool already init */
+    if (!heap_valid(heap)) {
+#ifdef VERBOSE
+        printf("ERROR: pool not init\n");
+#endif
+        return;
+    }
+
+    if (ptrs == NULL) {
+#ifdef VERBOSE
+        printf("ERROR: invalid block array\n");
+#endif
+        return;
+    }
+
+    /******* chain consecutive blocks of same pool and splice each chain onto free list *******/
+
+    uint8_t* head = NULL;
+    uint8_t* tail = NULL;
+    uint8_t head_pool = POOL_NONE;
+    for (size_t i = 0; i < count; i++) {
+        uint8_t pool;
+        pool_slab_t* slab;
+        uint8_t* hdr_ptr = blk_unmark(heap, ptrs[i], &pool, &slab);
+        if (hdr_ptr == NULL) {
+            continue;
+        }
+
+        /* bitmap pool block is free once findable, nothing to chain */
+        if (BLK_BMP_POOL(heap, pool)) {
+            blk_bmp_free(heap, pool, hdr_ptr);
+        }
+        else {
+            /* splice chain of previous pool */
+            if (head != NULL && pool != head_pool) {
+                blk_attach(heap, head_pool, head, tail);
+                head = NULL;
+            }
+
+            if (head == NULL) {
+                tail = hdr_ptr;
+                head_pool = pool;
+            }
+            BLK_SET_LINK(hdr_ptr, head);
+            head = hdr_ptr;
+
+#ifdef POOL_PARANOID
+            /* free list walk must see every freed block */
+            blk_attach(heap, head_pool, head, tail);
+            head = NULL;
+#else
+            /* slab release walks the free list, so splice chain first */
+            if (slab != NULL && heap->blk_avail != NULL) {
+                blk_attach(heap, head_pool, head, tail);
+                head = NULL;
+            }
+#endif
+        }
+        blk_freed(heap, pool, slab);
+#ifdef POOL_TRACE
+        if (heap->trace != NULL) {
+            heap->trace(heap->trace_ctx, POOL_TRACE_FREE, pool, ptrs[i], heap->blk_szs[pool]);
+        }
+#endif
+    }
+
+    if (head != NULL) {
+        blk_attach(heap, head_pool, head, tail);
+    }
+}
+
+static uint8_t* blk_unmark(pool_t* heap, void* ptr, uint8_t* pool_out, pool_slab_t** slab_out)
+{
+    /* verify pointer not NULL */
+    if (ptr == NULL) {
+#ifdef VERBOSE
+        printf("ERROR: cannot free NULL ptr\n");
+#endif
+        return NULL;
+    }
+
+    /* find pool, its blocks and bitmap - main heap between pool_base_addr[0] and max_heap pointer, otherwise a slab */
+    /* note: data ptr lies in the same pool as its header */
+    uint8_t* data_ptr = (uint8_t*)ptr;
+    uint8_t pool;
+    uint8_t* pool_base;
+    uint32_t pool_blks;
+    uint64_t* map;
+    pool_slab_t* slab = NULL;
+
+    if (data_ptr >= heap->pool_base_addrs[0] && data_ptr < heap->heap_max) {
+        pool = pool_find(heap, data_ptr);
+        pool_base = heap->pool_base_addrs[pool];
+        pool_blks = heap->blk_cnts[pool];
+        map = heap->blk_maps[pool];
+    }
+    else if ((slab = slab_find(heap, data_ptr)) != NULL) {
+        pool = slab->pool;
+        pool_base = slab->base;
+        pool_blks = slab->blk_cnt;
+        map = slab->map;
+    }
+    else {
+#ifdef VERBOSE
+        printf("ERROR: ptr not within valid heap boundaries\n");
+#endif
+        return NULL;
+    }
+
+    /* convert ptr from data to header, blocks of bitmap pools have none */
+    uint8_t* hdr_ptr = BLK_BMP_POOL(heap, pool) ? data_ptr : blk_data_to_hdr(data_ptr);
+
+    /* verify ptr is aligned with blocks in pool otherwise invalid pointer */
+    if (hdr_ptr < pool_base || ((hdr_ptr - pool_base) % heap->blk_mem_reqs[pool]) != 0) {
+#ifdef VERBOSE
+        printf("ERROR: unaligned block pointer\n");
+#endif
+        return NULL;
+    }
+
+    /* verify ptr is a block rather than the unused bytes at the end of the pool */
+    uint32_t blk_idx = (hdr_ptr - pool_base) / heap->blk_mem_reqs[pool];
+    if (blk_idx >= pool_blks) {
+#ifdef VERBOSE
+        printf("ERROR: ptr not within valid pool blocks\n");
+#endif
+        return NULL;
+    }
+
+    /* blocks past the carved ones are free, their bits may be left over from before a reset */
+    if (slab == NULL && blk_idx >= POOL_STAT_LOAD(BLK_CARVED(heap, pool))) {
+#ifdef VERBOSE
+        printf("ERROR: block already free\n");
+#endif
+        return NULL;
+    }
+
+#ifdef POOL_PARANOID
+    /* cross check bitmap by walking free list - O(free blocks), kept for benchmark comparison */
+    /* note: bitmap pools have no free list to cross check */
+    bool blk_free = !blk_map_test(map, blk_idx) && !BLK_BMP_POOL(heap, pool);
+    bool blk_listed = false;
+#ifdef POOL_CONCURRENT
+    pthread_mutex_lock(&heap->pool_locks[pool].mtx);
+#endif
+#ifdef POOL_LOCALITY
+    /* only the list of the block's page can hold it - O(free blocks of page) */
+    uint8_t* blk = BLK_BMP_POOL(heap, pool) ? NULL : blk_list_head(heap, pool, hdr_ptr);
+#else
+    uint8_t* blk = BLK_HEAD(heap, pool);
+#endif
+    while (blk != NULL) {
+        if (blk == hdr_ptr) {
+            blk_listed = true;
+            break;
+        }
+        blk = BLK_LINK(blk);
+    }
+#ifdef POOL_CHECKPOINTS
+    /* and the lists open checkpoints set aside */
+    for (pool_checkpoint_t* cp = heap->ckpt; cp != NULL && !blk_listed; cp = cp->prev) {
+        for (blk = cp->heads[pool]; blk != NULL && !blk_listed; blk = BLK_LINK(blk)) {
+            blk_listed = (blk == hdr_ptr);
+        }
+    }
+#endif
+#ifdef POOL_CONCURRENT
+    pthread_mutex_unlock(&heap->pool_locks[pool].mtx);
+
+    /* note: free blocks may also sit in thread magazines, so only listed implies free */
+    assert(!blk_listed || blk_free);
+#else
+    assert(blk_listed == blk_free);
+#endif
+#endif
+
+#ifdef POOL_CANARY
+    /* data overflowed into canary, block stays allocated rather than handing the damage to its next owner */
+    /* note: free block of headerless pool may hold its link over the canary, so only allocated blocks are checked */
+    uint64_t canary = BLK_CANARY(data_ptr);
+    if (!BLK_BMP_POOL(heap, pool)) {
+        memcpy(&canary, data_ptr + heap->blk_szs[pool], sizeof(canary));
+    }
+    if (canary != BLK_CANARY(data_ptr) && blk_map_test(map, blk_idx)) {
+#ifdef VERBOSE
+        printf("ERROR: block overflow, canary overwritten\n");
+#endif
+        POOL_STAT_ADD(heap->blk_stats[pool].faults, 1);
+        return NULL;
+    }
+#endif
+
+#ifdef BLK_GUARDED
+    /* fill before bitmap marks block free, a bitmap pool block can be claimed by another thread right after */
+    blk_guard_free(heap, pool, hdr_ptr);
+#endif
+
+    /* mark block free, verifying it is not already freed using allocation bitmap */
+    if (!blk_map_clear(map, blk_idx)) {
+#ifdef VERBOSE
+        printf("ERROR: block already free\n");
+#endif
+        return NULL;
+    }
+
+    *pool_out = pool;
+    *slab_out = slab;
+    return hdr_ptr;
+}
+
+static void blk_freed(pool_t* heap, uint8_t pool, pool_slab_t* slab)
+{
+    blk_stat(heap, pool, BLK_STAT_FREE);
+
+#ifndef POOL_THREADED
+    if (heap->blk_avail != NULL) {
+        heap->blk_avail[pool]++;
+    }
+
+    /* return empty slab to provider once pool keeps enough free blocks without it */
+    if (slab != NULL && --slab->blk_used == 0 && heap->blk_avail != NULL &&
+        heap->blk_avail[pool] >= slab->blk_cnt + heap->slab_release) {
+        slab_release(heap, slab);
+    }
+#else
+    (void)slab;
+#endif
+}
+
+bool pool_reset_from(pool_t* heap, uint8_t pool)
+{
+    if (!heap_valid(heap) || pool >= heap->blk_sz_cnt) {
+#ifdef VERBOSE
+        printf("ERROR: invalid pool\n");
+#endif
+        return false;
+    }
+
+#ifdef POOL_CHECKPOINTS
+    ckpt_drop(heap);
+#endif
+    blk_reset(heap, pool);
+    return true;
+}
+
+bool pool_reset_all_from(pool_t* heap)
+{
+    if (!heap_valid(heap)) {
+#ifdef VERBOSE
+        printf("ERROR: pool not init\n");
+#endif
+        return false;
+    }
+
+#ifdef POOL_CHECKPOINTS
+    ckpt_drop(heap);
+#endif
+    for (uint8_t i = 0; i < heap->blk_sz_cnt; i++) {
+        blk_reset(heap, i);
+    }
+    return true;
+}
+
+static void blk_reset(pool_t* heap, uint8_t pool)
+{
+#ifdef POOL_CONCURRENT
+    /* calling thread's cached blocks and pending counts belong to the pool being reset */
+    for (uint8_t i = 0; i < POOL_MAG_HEAPS; i++) {
+        blk_mag_t* mag = &tls_mags.mags[i];
+        if (mag->heap == heap && mag->heap_id == heap->id) {
+            blk_stat_add(heap, pool, &mag->stats[pool]);
+            mag->stats[pool] = (blk_stat_pend_t){ 0 };
+            mag->blks[pool] = NULL;
+            mag->cnts[pool] = 0;
+        }
+    }
+#endif
+
+    if (BLK_BMP_POOL(heap, pool)) {
+        /* bitmap pool is searched, not carved - O(blocks / 64) to clear its bitmap */
+        uint64_t* map = heap->blk_maps[pool];
+        for (size_t i = 0; i < BLK_MAP_WORDS(heap->blk_cnts[pool]); i++) {
+#ifdef BLK_GUARDED
+            for (uint64_t bits = map[i]; bits != 0; bits &= bits - 1) {
+                size_t blk_idx = i * BLK_MAP_BITS + __builtin_ctzll(bits);
+                if (blk_idx < heap->blk_cnts[pool]) {
+                    blk_guard_free(heap, pool, heap->pool_base_addrs[pool] + blk_idx * heap->blk_mem_reqs[pool]);
+                }
+            }
+#endif
+            POOL_STAT_STORE(map[i], 0);
+        }
+        blk_bmp_init(heap, pool);
+    }
+    else {
+        /* drop free list and carve blocks again from start of pool, stale bits past the carved ones are ignored */
+#ifdef BLK_ANNOTATE
+        BLK_NOACCESS(heap->pool_base_addrs[pool], (size_t)POOL_STAT_LOAD(BLK_CARVED(heap, pool)) * heap->blk_mem_reqs[pool]);
+#endif
+        blk_empty(heap, pool);
+        POOL_STAT_STORE(BLK_CARVED(heap, pool), 0);
+    }
+
+    /* slabs go back to provider if it takes them, otherwise every slab block is threaded onto free list again */
+#ifdef POOL_CONCURRENT
+    pthread_rwlock_wrlock(&heap->slab_lock);
+#endif
+    size_t slab_cnt = 0;
+    for (size_t i = 0; i < heap->slab_cnt; i++) {
+        pool_slab_t* slab = heap->slabs[i];
+        if (slab->pool == pool && heap->slab_free != NULL) {
+#ifdef BLK_ANNOTATE
+            BLK_ACCESS(slab, heap->slab_size);
+#endif
+            heap->slab_free(slab, heap->slab_size, heap->slab_ctx);
+            continue;
+        }
+        if (slab->pool == pool) {
+            slab_thread(heap, slab, 0);
+        }
+        heap->slabs[slab_cnt++] = slab;
+    }
+    heap->slab_cnt = slab_cnt;
+#ifdef POOL_CONCURRENT
+    pthread_rwlock_unlock(&heap->slab_lock);
+#endif
+    if (heap->blk_avail != NULL) {
+        heap->blk_avail[pool] = heap->blk_cnts[pool];
+    }
+
+    /* blocks in use count as freed */
+    blk_stat_t* st = &heap->blk_stats[pool];
+    POOL_STAT_STORE(st->cnts[BLK_STAT_FREE], POOL_STAT_LOAD(st->cnts[BLK_STAT_ALLOC]));
+}
+
+#ifdef POOL_CHECKPOINTS
+bool pool_checkpoint_from(pool_t* heap, pool_checkpoint_t* cp)
+{
+    if (!heap_valid(heap) || cp == NULL) {
+#ifdef VERBOSE
+        printf("ERROR: invalid checkpoint\n");
+#endif
+        return false;
+    }
+
+    /* note: slab blocks and bitmap pool blocks are not carved, so there is no mark to roll them back to */
+    if (heap->slab_alloc != NULL || heap->blk_bmps != NULL) {
+#ifdef VERBOSE
+        printf("ERROR: checkpoint needs fixed free list pools\n");
+#endif
+        return false;
+    }
+
+    /* set free lists aside, blocks allocated from here on are carved past the marks or freed again in scope */
+    cp->heap = heap;
+    cp->prev = heap->ckpt;
+    for (uint8_t i = 0; i < heap->blk_sz_cnt; i++) {
+        cp->heads[i] = heap->blk_alloc[i];
+        cp->marks[i] = BLK_CARVED(heap, i);
+        heap->blk_alloc[i] = NULL;
+    }
+    heap->ckpt = cp;
+    return true;
+}
+
+bool pool_rollback(pool_checkpoint_t* cp)
+{
+    if (cp == NULL || !heap_valid(cp->heap) || cp->heap->ckpt != cp) {
+#ifdef VERBOSE
+        printf("ERROR: not the innermost open checkpoint\n");
+#endif
+        return false;
+    }
+
+    pool_t* heap = cp->heap;
+    for (uint8_t i = 0; i < heap->blk_sz_cnt; i++) {
+        uint32_t mark = cp->marks[i];
+        uint32_t carved = BLK_CARVED(heap, i);
+
+        /* free list only holds blocks carved since checkpoint, older ones freed in scope went to the list set aside */
+        uint32_t dropped = 0;
+        for (uint8_t* blk = heap->blk_alloc[i]; blk != NULL; blk = BLK_LINK(blk)) {
+            dropped++;
+        }
+        heap->blk_alloc[i] = cp->heads[i];
+        BLK_CARVED(heap, i) = mark;
+#ifdef BLK_ANNOTATE
+        size_t blk_mem_req = heap->blk_mem_reqs[i];
+        BLK_NOACCESS(heap->pool_base_addrs[i] + (size_t)mark * blk_mem_req, (size_t)(carved - mark) * blk_mem_req);
+#endif
+
+        /* blocks carved since checkpoint and still in use count as freed */
+        heap->blk_stats[i].cnts[BLK_STAT_FREE] += carved - mark - dropped;
+    }
+    heap->ckpt = cp->prev;
+    return true;
+}
+
+static void ckpt_drop(pool_t* heap)
+{
+    /* note: blocks freed in scope are counted free already, so only their links move */
+    for (pool_checkpoint_t* cp = heap->ckpt; cp != NULL; cp = cp->prev) {
+        for (uint8_t i = 0; i < heap->blk_sz_cnt; i++) {
+            uint8_t* blk = cp->heads[i];
+            while (blk != NULL) {
+                uint8_t* next = BLK_LINK(blk);
+                BLK_SET_LINK(blk, heap->blk_alloc[i]);
+                heap->blk_alloc[i] = blk;
+                blk = next;
+            }
+            cp->heads[i] = NULL;
+        }
+    }
+    heap->ckpt = NULL;
+}
+#endif
+
+#ifdef POOL_BEST_FIT
+bool pool_get_frag_from(pool_t* heap, uint8_t pool, pool_frag_t* frag) {
+    if (!heap_valid(heap) || pool >= heap->blk_sz_cnt || frag == NULL) {
+        return false;
+    }
+
+    *frag = heap->blk_frags[pool];
+    return true;
+}
+#endif
+
+#ifdef POOL_TRACE
+bool pool_set_trace_from(pool_t* heap, pool_trace_t trace, void* ctx) {
+    if (!heap_valid(heap)) {
+        return false;
+    }
+
+    heap->trace = trace;
+    heap->trace_ctx = ctx;
+    return true;
+}
+
+void pool_capture(void* ctx, uint8_t event, uint8_t pool, void* ptr, size_t n) {
+    pool_capture_rec_t rec = {
+        .ticks = trace_ticks(),
+        .handle = (uintptr_t)ptr,
+        .size = (uint32_t)n,
+        .op = event,
+        .pool = pool,
+        .reserved = 0,
+    };
+
+    /* note: stdio locks the stream, so records of concurrent ops are not interleaved */
+    fwrite(&rec, sizeof(rec), 1, (FILE*)ctx);
+}
+
+bool pool_capture_start_from(pool_t* heap, FILE* out) {
+    if (!heap_valid(heap) || out == NULL) {
+        return false;
+    }
+
+    pool_capture_hdr_t hdr = { POOL_CAPTURE_MAGIC, POOL_CAPTURE_VERSION, sizeof(pool_capture_rec_t) };
+    if (fwrite(&hdr, sizeof(hdr), 1, out) != 1) {
+#ifdef VERBOSE
+        printf("ERROR: cannot write capture header\n");
+#endif
+        return false;
+    }
+    return pool_set_trace_from(heap, pool_capture, out);
+}
+
+bool pool_set_lat_from(pool_t* heap, pool_lat_t* lats) {
+    if (!heap_valid(heap)) {
+        return false;
+    }
+
+    if (lats != NULL) {
+        for (uint8_t i = 0; i < heap->blk_sz_cnt; i++) {
+            lats[i] = (pool_lat_t){ 0 };
+        }
+    }
+    heap->blk_lats = lats;
+    return true;
+}
+
+bool pool_get_lat_from(pool_t* heap, uint8_t pool, pool_lat_t* lat) {
+    if (!heap_valid(heap) || pool >= heap->blk_sz_cnt || lat == NULL || heap->blk_lats == NULL) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < POOL_LAT_BUCKETS; i++) {
+        lat->malloc_ticks[i] = POOL_STAT_LOAD(heap->blk_lats[pool].malloc_ticks[i]);
+        lat->free_ticks[i] = POOL_STAT_LOAD(heap->blk_lats[pool].free_ticks[i]);
+    }
+    return true;
+}
+
+static inline uint64_t trace_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static inline void trace_lat(uint64_t* hist, uint64_t t0) {
+    uint64_t ticks = trace_ticks() - t0;
+    uint8_t bucket = (ticks < 2) ? 0 : 63 - __builtin_clzll(ticks);
+    if (bucket >= POOL_LAT_BUCKETS) {
+        bucket = POOL_LAT_BUCKETS - 1;
+    }
+    POOL_STAT_ADD(hist[bucket], 1);
+}
+#endif
+
+#ifdef POOL_NUMA
+/* Description: get online NUMA nodes from sysfs, e.g. "0" or "0-1,3"
+ * Args: void
+ * Return: bit mask of online nodes below 64, node 0 alone if unknown
+ */
+static uint64_t numa_online(void) {
+    FILE* f = fopen("/sys/devices/system/node/online", "r");
+    if (f == NULL) {
+        return 1;
+    }
+
+    uint64_t mask = 0;
+    uint32_t lo;
+    while (fscanf(f, "%u", &lo) == 1) {
+        uint32_t hi = lo;
+        int c = fgetc(f);
+        if (c == '-' && fscanf(f, "%u", &hi) == 1) {
+            c = fgetc(f);
+        }
+        for (uint32_t node = lo; node <= hi && node < 64; node++) {
+            mask |= (uint64_t)1 << node;
+        }
+        if (c != ',') {
+            break;
+        }
+    }
+    fclose(f);
+    return (mask != 0) ? mask : 1;
+}
+
+/* Description: get node of calling thread's default instance
+ * Args: void
+ * Return: node index below g_numa_cnt
+ */
+static uint8_t numa_node(void) {
+    if (tls_numa_node >= 0) {
+        return (uint8_t)(tls_numa_node % g_numa_cnt);
+    }
+
+    /* note: thread may migrate, refresh now and then instead of paying a syscall per call */
+    if (tls_numa_ops == 0) {
+        unsigned node = 0;
+        if (syscall(SYS_getcpu, NULL, &node, NULL) != 0) {
+            node = 0;
+        }
+        tls_numa_seen = node;
+        tls_numa_ops = NUMA_NODE_REFRESH;
+    }
+    tls_numa_ops--;
+
+    /* simulated nodes beyond those online are only reached through pool_numa_set_node */
+    return (uint8_t)(tls_numa_seen % g_numa_cnt);
+}
+
+/* Description: get default instance holding ptr, any node
+ * Args: ptr - address
+ * Return: instance owning ptr, calling thread's instance if none does
+ */
+static pool_t* numa_home(const void* ptr) {
+    for (uint8_t i = 0; i < g_numa_cnt; i++) {
+        if (pool_owns_from(g_numa_pools[i], ptr)) {
+            return g_numa_pools[i];
+        }
+    }
+    return g_numa_pools[numa_node()];
+}
+#endif
+
+/* Description: get default instance of calling thread, its node's instance with pool_init_numa
+ * Args: void
+ * Return: instance, NULL if not init
+ */
+static inline pool_t* pool_local(void) {
+#ifdef POOL_NUMA
+    if (g_numa_cnt > 0) {
+        return g_numa_pools[numa_node()];
+    }
+#endif
+    return g_pool;
+}
+
+bool pool_init(const size_t* block_sizes, size_t block_size_count)
+{
+    pool_cfg_t cfg = { .block_sizes = block_sizes, .block_size_count = block_size_count };
+    return pool_init_cfg(&cfg);
+}
+
+bool pool_init_cfg(const pool_cfg_t* cfg)
+{
+    /* verify pool not already init */
+    if (g_pool != NULL) {
+#ifdef VERBOSE
+        printf("ERROR: pool already init\n");
+#endif
+        return false;
+    }
+
+    g_pool = pool_create_cfg(g_pool_heap, sizeof(g_pool_heap), cfg);
+    return g_pool != NULL;
+}
+
+#ifdef POOL_NUMA
+bool pool_init_numa(const pool_cfg_t* cfg, uint8_t node_cnt)
+{
+    /* verify pool not already init */
+    if (g_pool != NULL) {
+#ifdef VERBOSE
+        printf("ERROR: pool already init\n");
+#endif
+        return false;
+    }
+
+    /* note: node ids may have gaps, default count spans up to the highest online node */
+    uint64_t online = numa_online();
+    if (node_cnt == 0) {
+        uint32_t node_max = 64 - __builtin_clzll(online);
+        node_cnt = (node_max > POOL_NUMA_NODES) ? POOL_NUMA_NODES : (uint8_t)node_max;
+    }
+    if (node_cnt > POOL_NUMA_NODES) {
+#ifdef VERBOSE
+        printf("ERROR: more than POOL_NUMA_NODES nodes\n");
+#endif
+        return false;
+    }
+
+    pool_t* heaps[POOL_NUMA_NODES];
+    void* mems[POOL_NUMA_NODES];
+    size_t lens[POOL_NUMA_NODES];
+    for (uint8_t i = 0; i < node_cnt; i++) {
+        lens[i] = POOL_HEAP_SIZE;
+        void* mem = mems[i] = pool_map(&lens[i], false);
+
+        /* bind before pool_create first touches the heap, a node not online or simulated keeps first-touch placement */
+        bool bound = true;
+        if (mem != NULL && (online >> i) & 1) {
+            unsigned long mask = 1UL << i;
+            bound = syscall(SYS_mbind, mem, lens[i], NUMA_MPOL_BIND, &mask, sizeof(mask) * 8 + 1, 0) == 0;
+#ifdef VERBOSE
+            if (!bound) {
+                printf("ERROR: numa bind failed\n");
+            }
+#endif
+        }
+
+        heaps[i] = (mem != NULL && bound) ? pool_create_cfg(mem, lens[i], cfg) : NULL;
+        if (heaps[i] == NULL) {
+            if (mem != NULL) {
+                pool_unmap(mem, lens[i]);
+            }
+            for (uint8_t j = 0; j < i; j++) {
+                pool_destroy(heaps[j]);
+                pool_unmap(mems[j], lens[j]);
+            }
+            return false;
+        }
+    }
+
+    for (uint8_t i = 0; i < node_cnt; i++) {
+        g_numa_pools[i] = heaps[i];
+    }
+    g_numa_cnt = node_cnt;
+    g_pool = heaps[0];
+    return true;
+}
+
+void pool_numa_set_node(int node)
+{
+    tls_numa_node = node;
+}
+
+pool_t* pool_numa_heap(uint8_t node)
+{
+    return (node < g_numa_cnt) ? g_numa_pools[node] : NULL;
+}
+#endif
+
+void* pool_malloc(size_t n)
+{
+    return pool_malloc_from(pool_local(), n);
+}
+
+size_t pool_malloc_batch(size_t n, void** out, size_t count)
+{
+    return pool_malloc_batch_from(pool_local(), n, out, count);
+}
+
+void pool_free_batch(void** ptrs, size_t count)
+{
+#ifdef POOL_NUMA
+    /* route each run of blocks from the same node to its home instance */
+    if (g_numa_cnt > 1) {
+        size_t start = 0;
+        while (start < count) {
+            pool_t* home = numa_home(ptrs[start]);
+            size_t end = start + 1;
+            while (end < count && (ptrs[end] == NULL || pool_owns_from(home, ptrs[end]))) {
+                end++;
+            }
+            pool_free_batch_from(home, ptrs + start, end - start);
+            start = end;
+        }
+        return;
+    }
+#endif
+    pool_free_batch_from(pool_local(), ptrs, count);
+}
+
+void* pool_malloc_aligned(size_t n, size_t align)
+{
+    return pool_malloc_aligned_from(pool_local(), n, align);
+}
+
+void pool_free(void* ptr)
+{
+#ifdef POOL_NUMA
+    /* block goes back to its home node, whichever node frees it */
+    if (g_numa_cnt > 1) {
+        pool_free_from(numa_home(ptr), ptr);
+        return;
+    }
+#endif
+    pool_free_from(pool_local(), ptr);
+}
+
+bool pool_owns_from(pool_t* heap, const void* ptr) {
+    if (!heap_valid(heap) || ptr == NULL) {
+        return false;
+    }
+
+    /* note: data ptr lies in the same pool or slab as its header */
+    const uint8_t* data_ptr = (const uint8_t*)ptr;
+    return (data_ptr >= heap->pool_base_addrs[0] && data_ptr < heap->heap_max) || slab_find(heap, data_ptr) != NULL;
+}
+
+bool pool_owns(const void* ptr) {
+#ifdef POOL_NUMA
+    if (g_numa_cnt > 1) {
+        return pool_owns_from(numa_home(ptr), ptr);
+    }
+#endif
+    return pool_owns_from(pool_local(), ptr);
+}
+
+bool pool_reset(uint8_t pool) {
+    return pool_reset_from(pool_local(), pool);
+}
+
+bool pool_reset_all(void) {
+    return pool_reset_all_from(pool_local());
+}
+
+#ifdef POOL_CHECKPOINTS
+bool pool_checkpoint(pool_checkpoint_t* cp) {
+    return pool_checkpoint_from(pool_local(), cp);
+}
+#endif
+
+#ifdef POOL_BEST_FIT
+bool pool_get_frag(uint8_t pool, pool_frag_t* frag) {
+    return pool_get_frag_from(pool_local(), pool, frag);
+}
+#endif
+
+#ifdef POOL_TRACE
+bool pool_set_trace(pool_trace_t trace, void* ctx) {
+    return pool_set_trace_from(pool_local(), trace, ctx);
+}
+
+bool pool_capture_start(FILE* out) {
+    return pool_capture_start_from(pool_local(), out);
+}
+
+bool pool_set_lat(pool_lat_t* lats) {
+    return pool_set_lat_from(pool_local(), lats);
+}
+
+bool pool_get_lat(uint8_t pool, pool_lat_t* lat) {
+    return pool_get_lat_from(pool_local(), pool, lat);
+}
+#endif
+
+void* pool_map(size_t* len, bool huge)
+{
+#ifdef __unix__
+    if (len == NULL || *len == 0) {
+        return NULL;
+    }
+
+    if (huge) {
+        /* huge pages need huge page multiple */
+        size_t map_len = (*len + POOL_HUGE_PAGE - 1) / POOL_HUGE_PAGE * POOL_HUGE_PAGE;
+        void* mem = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+        /* explicit huge pages, only succeeds if huge pages are reserved */
+        mem = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+
+        if (mem == MAP_FAILED) {
+            /* huge page aligned region for transparent huge pages */
+            mem = map_aligned(map_len, POOL_HUGE_PAGE);
+            if (mem == NULL) {
+                return NULL;
+            }
+
+#ifdef MADV_HUGEPAGE
+            madvise(mem, map_len, MADV_HUGEPAGE);
+#endif
+        }
+
+        *len = map_len;
+        return mem;
+    }
+
+    void* mem = mmap(NULL, *len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return (mem == MAP_FAILED) ? NULL : mem;
+#else
+    (void)len;
+    (void)huge;
+    return NULL;
+#endif
+}
+
+void pool_unmap(void* mem, size_t len)
+{
+#ifdef __unix__
+    if (mem != NULL) {
+        munmap(mem, len);
+    }
+#else
+    (void)mem;
+    (void)len;
+#endif
+}
+
+void* pool_slab_map(size_t len, void* ctx)
+{
+    (void)ctx;
+    return map_aligned(len, len);
+}
+
+void pool_slab_unmap(void* mem, size_t len, void* ctx)
+{
+    (void)ctx;
+    pool_unmap(mem, len);
+}
+
+static void* map_aligned(size_t len, size_t align) {
+#ifdef __unix__
+    /* over map so an aligned region can be trimmed out */
+    uint8_t* raw = mmap(NULL, len + align, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        return NULL;
+    }
+
+    uint8_t* aligned = raw + (align - ((uintptr_t)raw % align)) % align;
+    if (aligned > raw) {
+        munmap(raw, aligned - raw);
+    }
+    if (raw + len + align > aligned + len) {
+        munmap(aligned + len, (raw + len + align) - (aligned + len));
+    }
+    return aligned;
+#else
+    (void)len;
+    (void)align;
+    return NULL;
+#endif
+}
+
+static bool pool_split(const pool_t* heap, const pool_cfg_t* cfg, size_t bytes, size_t* pool_sizes) {
+    /* pools with explicit block counts get exactly what they need */
+    uint64_t weight_sum = 0;
+    for (uint8_t i = 0; i < heap->blk_sz_cnt; i++) {
+        size_t blk_mem_req = heap->blk_mem_reqs[i];
+        size_t blk_pad = (heap->blk_aligns[i] > BLK_ALIGN_MIN) ? heap->blk_aligns[i] - BLK_ALIGN_MIN : 0;
+        pool_sizes[i] = 0;
+
+        /* note: plus worst case padding to align first block, pool shares start BLK_ALIGN_MIN aligned */
+        if (cfg->block_counts != NULL && cfg->block_counts[i] > 0) {
+            if (bytes < blk_pad || cfg->block_counts[i] > (bytes - blk_pad) / blk_mem_req) {
+                return false;
+            }
+            pool_sizes[i] = cfg->block_counts[i] * blk_mem_req + blk_pad;
+            bytes -= pool_sizes[i];
+        }
+        else {
+            weight_sum += (cfg->weights == NULL) ? 1 : cfg->weights[i];
+        }
+    }
+
+    /* remaining pools share the rest in proportion to their weights */
+    /* note: split as (bytes / sum) * w + (bytes % sum) * w / sum to avoid overflow */
+    for (uint8_t i = 0; i < heap->blk_sz_cnt; i++) {
+        if (pool_sizes[i] == 0) {
+            uint64_t weight = (cfg->weights == NULL) ? 1 : cfg->weights[i];
+            pool_sizes[i] = (bytes / weight_sum) * weight + (bytes % weight_sum) * weight / weight_sum;
+            /* keep next pool share BLK_ALIGN_MIN aligned */
+            pool_sizes[i] -= pool_sizes[i] % BLK_ALIGN_MIN;
+        }
+    }
+    return true;
+}
+
+bool pool_get_info_from(pool_t* heap, uint8_t pool, pool_info_t* info) {
+    if (!heap_valid(heap) || pool >= heap->blk_sz_cnt || info == NULL) {
+        return false;
+    }
+
+    uint8_t* pool_end = (pool + 1 < heap->blk_sz_cnt) ? heap->pool_base_addrs[pool + 1] : heap->pool_max;
+    info->blk_sz = heap->blk_szs[pool];
+    info->blk_align = heap->blk_aligns[pool];
+    info->blk_cnt = heap->blk_cnts[pool];
+    info->pool_bytes = pool_end - heap->pool_base_addrs[pool];
+    info->slack_bytes = info->pool_bytes - info->blk_cnt * heap->blk_mem_reqs[pool];
+    info->slab_cnt = 0;
+    info->slab_blk_cnt = 0;
+    info->bitmap = BLK_BMP_POOL(heap, pool);
+
+#ifdef POOL_CONCURRENT
+    pthread_rwlock_rdlock(&heap->slab_lock);
+#endif
+    for (size_t i = 0; i < heap->slab_cnt; i++) {
+        if (heap->slabs[i]->pool == pool) {
+            info->slab_cnt++;
+            info->slab_blk_cnt += heap->slabs[i]->blk_cnt;
+        }
+    }
+#ifdef POOL_CONCURRENT
+    pthread_rwlock_unlock(&heap->slab_lock);
+#endif
+    return true;
+}
+
+bool pool_get_info(uint8_t pool, pool_info_t* info) {
+    return pool_get_info_from(pool_local(), pool, info);
+}
+
+bool pool_get_stats_from(pool_t* heap, uint8_t pool, pool_stats_t* stats) {
+    pool_info_t info;
+    if (stats == NULL || !pool_get_info_from(heap, pool, &info)) {
+        return false;
+    }
+
+#ifdef POOL_CONCURRENT
+    /* fold calling thread's pending counts so its own ops are visible */
+    for (uint8_t i = 0; i < POOL_MAG_HEAPS; i++) {
+        blk_mag_t* mag = &tls_mags.mags[i];
+        if (mag->heap == heap && mag->heap_id == heap->id) {
+            blk_stat_add(heap, pool, &mag->stats[pool]);
+            mag->stats[pool] = (blk_stat_pend_t){ 0 };
+        }
+    }
+#endif
+
+    /* note: frees before allocs are read, and with lazily folded counts, frees may briefly exceed allocs */
+    blk_stat_t* st = &heap->blk_stats[pool];
+    stats->frees = POOL_STAT_LOAD(st->cnts[BLK_STAT_FREE]);
+    stats->allocs = POOL_STAT_LOAD(st->cnts[BLK_STAT_ALLOC]);
+    stats->failures = POOL_STAT_LOAD(st->cnts[BLK_STAT_FAIL]);
+    stats->high_water = POOL_STAT_LOAD(st->high_water);
+#if defined(POOL_CANARY) || defined(POOL_POISON)
+    stats->faults = POOL_STAT_LOAD(st->faults);
+#endif
+    stats->in_use = (stats->allocs > stats->frees) ? stats->allocs - stats->frees : 0;
+
+    size_t blk_total = info.blk_cnt + info.slab_blk_cnt;
+    stats->free_blks = (blk_total > stats->in_use) ? blk_total - stats->in_use : 0;
+    return true;
+}
+
+bool pool_get_stats(uint8_t pool, pool_stats_t* stats) {
+    return pool_get_stats_from(pool_local(), pool, stats);
+}
+
+static bool heap_valid(const pool_t* heap) {
+    return heap != NULL && heap->magic == POOL_MAGIC;
+}
+
+#ifdef POOL_THREADED
+static void blk_stat_add(pool_t* heap, uint8_t pool, const blk_stat_pend_t* pend) {
+    blk_stat_t* st = &heap->blk_stats[pool];
+    uint64_t frees = POOL_STAT_ADD(st->cnts[BLK_STAT_FREE], pend->cnts[BLK_STAT_FREE]);
+    uint64_t allocs = POOL_STAT_ADD(st->cnts[BLK_STAT_ALLOC], pend->cnts[BLK_STAT_ALLOC]);
+    POOL_STAT_ADD(st->cnts[BLK_STAT_FAIL], pend->cnts[BLK_STAT_FAIL]);
+
+    /* raise high water mark to blocks in use before these counts plus their peak */
+    /* note: lazily folded frees of other threads may be ahead of allocs, in use taken as 0 then */
+    if (pend->peak == 0) {
+        return;
+    }
+    uint64_t in_use = ((allocs > frees) ? allocs - frees : 0) + pend->peak;
+    uint64_t high_water = __atomic_load_n(&st->high_water, __ATOMIC_RELAXED);
+    while (in_use > high_water &&
+           !__atomic_compare_exchange_n(&st->high_water, &high_water, in_use, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+/* Description: count alloc, free or failure in pending counts
+ * Args: pend - pending counts of pool
+ *       stat - BLK_STAT_ALLOC, BLK_STAT_FREE or BLK_STAT_FAIL
+ * Return: void
+ */
+static inline void blk_stat_pend(blk_stat_pend_t* pend, uint8_t stat) {
+    pend->cnts[stat]++;
+    int32_t net = (int32_t)pend->cnts[BLK_STAT_ALLOC] - (int32_t)pend->cnts[BLK_STAT_FREE];
+    if (stat == BLK_STAT_ALLOC && net > (int32_t)pend->peak) {
+        pend->peak = (uint16_t)net;
+    }
+}
+#endif
+
+#ifdef POOL_CONCURRENT
+static inline void blk_stat(pool_t* heap, uint8_t pool, uint8_t stat) {
+    /* count in thread magazine, folded into instance counters every POOL_MAG_BATCH counts */
+    blk_mag_t* mag = mag_get(heap);
+    if (mag == NULL) {
+        blk_stat_pend_t pend = { 0 };
+        blk_stat_pend(&pend, stat);
+        blk_stat_add(heap, pool, &pend);
+        return;
+    }
+
+    blk_stat_pend_t* pend = &mag->stats[pool];
+    blk_stat_pend(pend, stat);
+    if (pend->cnts[BLK_STAT_ALLOC] + pend->cnts[BLK_STAT_FREE] + pend->cnts[BLK_STAT_FAIL] >= POOL_MAG_BATCH) {
+        blk_stat_add(heap, pool, pend);
+        *pend = (blk_stat_pend_t){ 0 };
+    }
+}
+#elif defined(POOL_LOCKFREE)
+static inline void blk_stat(pool_t* heap, uint8_t pool, uint8_t stat) {
+    blk_stat_pend_t pend = { 0 };
+    blk_stat_pend(&pend, stat);
+    blk_stat_add(heap, pool, &pend);
+}
+#else
+static inline void blk_stat(pool_t* heap, uint8_t pool, uint8_t stat) {
+    blk_stat_t* st = &heap->blk_stats[pool];
+    st->cnts[stat]++;
+
+    if (stat == BLK_STAT_ALLOC && st->cnts[BLK_STAT_ALLOC] - st->cnts[BLK_STAT_FREE] > st->high_water) {
+        st->high_water = st->cnts[BLK_STAT_ALLOC] - st->cnts[BLK_STAT_FREE];
+    }
+}
+#endif
+
+static bool cfg_bitmap(const pool_cfg_t* cfg, uint8_t pool) {
+    return cfg->bitmaps != NULL && cfg->bitmaps[pool];
+}
+
+static size_t cfg_align(const pool_cfg_t* cfg, uint8_t pool) {
+    size_t align_min = cfg_bitmap(cfg, pool) ? 1 : BLK_ALIGN_MIN;
+    return (cfg->alignments == NULL || cfg->alignments[pool] < align_min) ? align_min : cfg->alignments[pool];
+}
+
+static size_t slab_blks(size_t slab_size, size_t blk_mem_req, size_t blk_align, size_t* blk_off) {
+    /* note: bitmap sized for blocks ignoring bitmap is an upper bound, as in pool_create_cfg */
+    /* note: slab start is slab_size aligned, so alignment of offsets is alignment of addresses */
+    *blk_off = 0;
+    if (slab_size < sizeof(pool_slab_t)) {
+        return 0;
+    }
+    size_t max_blks = (slab_size - sizeof(pool_slab_t)) / blk_mem_req;
+    size_t hdr_size = sizeof(pool_slab_t) + BLK_MAP_WORDS(max_blks) * sizeof(uint64_t);
+    *blk_off = hdr_size + BLK_ALIGN_OFF(hdr_size, BLK_HDR_SIZE, blk_align);
+    return (slab_size < *blk_off) ? 0 : (slab_size - *blk_off) / blk_mem_req;
+}
+
+static uint8_t* pool_grow(pool_t* heap, uint8_t pool) {
+#ifdef POOL_CONCURRENT
+    pthread_rwlock_wrlock(&heap->slab_lock);
+
+    /* another thread may have grown pool while waiting for lock */
+    uint8_t* blk = blk_pop(heap, pool);
+    if (blk != NULL) {
+        pthread_rwlock_unlock(&heap->slab_lock);
+        return blk;
+    }
+#endif
+
+    uint8_t* mem = NULL;
+    if (heap->slab_cnt < heap->slab_max) {
+        mem = heap->slab_alloc(heap->slab_size, heap->slab_ctx);
+    }
+
+    /* slabs must be aligned to their size so blocks find their slab by masking */
+    if (mem != NULL && ((uintptr_t)mem & (heap->slab_size - 1)) != 0) {
+#ifdef VERBOSE
+        printf("ERROR: unaligned slab\n");
+#endif
+        if (heap->slab_free != NULL) {
+            heap->slab_free(mem, heap->slab_size, heap->slab_ctx);
+        }
+        mem = NULL;
+    }
+
+    if (mem == NULL) {
+#ifdef POOL_CONCURRENT
+        pthread_rwlock_unlock(&heap->slab_lock);
+#endif
+        return NULL;
+    }
+
+    /* init slab header, bitmap is cleared when blocks are threaded */
+    pool_slab_t* slab = (pool_slab_t*)mem;
+    size_t blk_off;
+    slab->pool = pool;
+    slab->blk_cnt = slab_blks(heap->slab_size, heap->blk_mem_reqs[pool], heap->blk_aligns[pool], &blk_off);
+    slab->base = mem + blk_off;
+
+    /* insert into registry, kept sorted by address for slab_find */
+    size_t pos = heap->slab_cnt;
+    while (pos > 0 && (uint8_t*)heap->slabs[pos - 1] > mem) {
+        heap->slabs[pos] = heap->slabs[pos - 1];
+        pos--;
+    }
+    heap->slabs[pos] = slab;
+    heap->slab_cnt++;
+
+#ifdef POOL_CONCURRENT
+    pthread_rwlock_unlock(&heap->slab_lock);
+#endif
+
+    /* first block goes to caller, rest are threaded onto pool free list */
+    slab_thread(heap, slab, 1);
+
+#ifndef POOL_THREADED
+    if (heap->blk_avail != NULL) {
+        heap->blk_avail[pool] += slab->blk_cnt;
+    }
+#endif
+
+    return slab->base;
+}
+
+static void slab_thread(pool_t* heap, pool_slab_t* slab, uint32_t first) {
+    size_t blk_mem_req = heap->blk_mem_reqs[slab->pool];
+    slab->blk_used = 0;
+    for (size_t i = 0; i < BLK_MAP_WORDS(slab->blk_cnt); i++) {
+        slab->map[i] = 0;
+    }
+
+#ifdef BLK_GUARDED
+    /* every block starts out free, blocks left to caller are unpoisoned again when marked allocated */
+    for (uint32_t i = 0; i < slab->blk_cnt; i++) {
+        blk_guard_free(heap, slab->pool, slab->base + (size_t)i * blk_mem_req);
+    }
+#endif
+
+    if (first < slab->blk_cnt) {
+        uint8_t* head = slab->base + (size_t)first * blk_mem_req;
+        uint8_t* tail = slab->base + (size_t)(slab->blk_cnt - 1) * blk_mem_req;
+        for (uint8_t* link = head; link < tail; link += blk_mem_req) {
+            BLK_SET_LINK(link, link + blk_mem_req);
+        }
+        blk_attach(heap, slab->pool, head, tail);
+    }
+}
+
+static pool_slab_t* slab_find(pool_t* heap, const uint8_t* ptr) {
+    pool_slab_t* slab = NULL;
+
+#ifdef POOL_CONCURRENT
+    pthread_rwlock_rdlock(&heap->slab_lock);
+#endif
+
+    /* binary search for last slab <= ptr */
+    size_t lo = 0;
+    size_t hi = heap->slab_cnt;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if ((const uint8_t*)heap->slabs[mid] <= ptr) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    if (lo > 0 && ptr < (uint8_t*)heap->slabs[lo - 1] + heap->slab_size) {
+        slab = heap->slabs[lo - 1];
+    }
+
+#ifdef POOL_CONCURRENT
+    pthread_rwlock_unlock(&heap->slab_lock);
+#endif
+    return slab;
+}
+
+static inline uint32_t blk_locate(const pool_t* heap, uint8_t pool, uint8_t* blk, pool_slab_t** slab) {
+    size_t blk_mem_req = heap->blk_mem_reqs[pool];
+    if (blk >= heap->pool_base_addrs[0] && blk < heap->pool_max) {
+        *slab = NULL;
+        return (blk - heap->pool_base_addrs[pool]) / blk_mem_req;
+    }
+
+    /* slab header at start of slab */
+    *slab = (pool_slab_t*)((uintptr_t)blk & ~(uintptr_t)(heap->slab_size - 1));
+    return (blk - (*slab)->base) / blk_mem_req;
+}
+
+#ifndef POOL_THREADED
+static void slab_release(pool_t* heap, pool_slab_t* slab) {
+    uint8_t pool = slab->pool;
+    uint8_t* slab_min = (uint8_t*)slab;
+    uint8_t* slab_max = slab_min + heap->slab_size;
+
+    /* unlink free blocks of slab from free list - O(free blocks), bounded by watermark hysteresis */
+    uint8_t* prev = NULL;
+    uint8_t* blk = heap->blk_alloc[pool];
+    while (blk != NULL) {
+        uint8_t* next = BLK_LINK(blk);
+        if (blk >= slab_min && blk < slab_max) {
+            if (prev == NULL) {
+                heap->blk_alloc[pool] = next;
+            }
+            else {
+                BLK_SET_LINK(prev, next);
+            }
+        }
+        else {
+            prev = blk;
+        }
+        blk = next;
+    }
+    heap->blk_avail[pool] -= slab->blk_cnt;
+
+    /* remove from registry */
+    size_t pos = 0;
+    while (heap->slabs[pos] != slab) {
+        pos++;
+    }
+    for (; pos + 1 < heap->slab_cnt; pos++) {
+        heap->slabs[pos] = heap->slabs[pos + 1];
+    }
+    heap->slab_cnt--;
+
+#ifdef BLK_ANNOTATE
+    BLK_ACCESS(slab, heap->slab_size);
+#endif
+    heap->slab_free(slab, heap->slab_size, heap->slab_ctx);
+}
+#endif
+
+#ifdef POOL_CONCURRENT
+/* Description: find calling thread's magazine for instance, claiming a free one if needed
+ * Args: heap - allocator instance
+ * Return: magazine, NULL if thread already caches POOL_MAG_HEAPS other instances
+ */
+static blk_mag_t* mag_get(pool_t* heap) {
+    blk_mag_t* free_mag = NULL;
+
+    for (uint8_t i = 0; i < POOL_MAG_HEAPS; i++) {
+        blk_mag_t* mag = &tls_mags.mags[i];
+        if (mag->heap == heap) {
+            if (mag->heap_id == heap->id) {
+                return mag;
+            }
+
+            /* instance destroyed and recreated at same address, cached blocks are stale */
+            *mag = (blk_mag_t){ 0 };
+        }
+        if (mag->heap == NULL && free_mag == NULL) {
+            free_mag = mag;
+        }
+    }
+
+    if (free_mag != NULL) {
+        /* register so magazines are flushed when thread exits */
+        if (!tls_mags.reg) {
+            tls_mags.reg = true;
+            pthread_setspecific(mag_key, &tls_mags);
+        }
+
+        free_mag->heap = heap;
+        free_mag->heap_id = heap->id;
+    }
+    return free_mag;
+}
+
+/* Description: take every block on remote free stack of a pool
+ * Args: heap - instance
+ *       pool - pool index
+ * Return: chain of blocks ending in NULL, NULL if stack empty
+ */
+static uint8_t* blk_remote_take(pool_t* heap, uint8_t pool) {
+    /* skip the exchange while stack is empty, keeps the line shared */
+    if (__atomic_load_n(&heap->blk_remotes[pool].head, __ATOMIC_RELAXED) == NULL) {
+        return NULL;
+    }
+
+    /* note: whole stack taken at once, so pushes never race a pop of a single block and there is no ABA */
+    return __atomic_exchange_n(&heap->blk_remotes[pool].head, NULL, __ATOMIC_ACQUIRE);
+}
+
+static uint8_t* blk_detach(pool_t* heap, uint8_t pool, uint32_t* cnt) {
+    uint32_t max = *cnt;
+    *cnt = 0;
+
+    pthread_mutex_lock(&heap->pool_locks[pool].mtx);
+    uint8_t* head = NULL;
+    uint8_t* tail = NULL;
+    uint8_t* blk = heap->blk_alloc[pool];
+    while (*cnt < max) {
+        /* shared list ran out, continue with every block freed remotely since last drain */
+        if (blk == NULL) {
+            if ((blk = blk_remote_take(heap, pool)) == NULL) {
+                break;
+            }
+            if (tail != NULL) {
+                BLK_SET_LINK(tail, blk);
+            }
+        }
+        if (head == NULL) {
+            head = blk;
+        }
+        tail = blk;
+        blk = BLK_LINK(tail);
+        (*cnt)++;
+    }
+    heap->blk_alloc[pool] = blk;
+    pthread_mutex_unlock(&heap->pool_locks[pool].mtx);
+
+    /* both lists ran dry, carve the rest from the untouched end of the pool */
+    while (*cnt < max && (blk = blk_carve(heap, pool)) != NULL) {
+        if (head == NULL) {
+            head = blk;
+        }
+        else {
+            BLK_SET_LINK(tail, blk);
+        }
+        tail = blk;
+        (*cnt)++;
+    }
+
+    /* detached chain is private to this thread now */
+    if (tail != NULL) {
+        BLK_SET_LINK(tail, NULL);
+    }
+    return head;
+}
+
+static void blk_empty(pool_t* heap, uint8_t pool) {
+    pthread_mutex_lock(&heap->pool_locks[pool].mtx);
+    heap->blk_alloc[pool] = NULL;
+    __atomic_store_n(&heap->blk_remotes[pool].head, NULL, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&heap->pool_locks[pool].mtx);
+}
+
+/* push chain onto remote free stack with a single CAS, allocating threads drain it on their next miss */
+static void blk_attach(pool_t* heap, uint8_t pool, uint8_t* head, uint8_t* tail) {
+    uint8_t* old = __atomic_load_n(&heap->blk_remotes[pool].head, __ATOMIC_RELAXED);
+    do {
+        BLK_SET_LINK(tail, old);
+    } while (!__atomic_compare_exchange_n(&heap->blk_remotes[pool].head, &old, head, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
 
-#include "pool_alloc.h"
+/* Description: move cached blocks beyond the first keep blocks from thread magazine to remote free stack
+ * Args: mag - magazine
+ *       pool - pool index
+ *       keep - # of most recently freed blocks to keep cached
+ * Return: void
+ */
+static void mag_flush(blk_mag_t* mag, uint8_t pool, uint16_t keep) {
+    if (mag->cnts[pool] <= keep) {
+        return;
+    }
 
-static uint8_t g_pool_heap[65536];
-static bool g_pool_heap_init = false;
-static uint8_t* g_pool_heap_max = g_pool_heap + sizeof(g_pool_heap);
+    /* split magazine after first keep blocks, walking before the chain is published */
+    uint8_t* prev = NULL;
+    uint8_t* head = mag->blks[pool];
+    for (uint16_t i = 0; i < keep; i++) {
+        prev = head;
+        head = BLK_LINK(head);
+    }
+    if (prev == NULL) {
+        mag->blks[pool] = NULL;
+    }
+    else {
+        BLK_SET_LINK(prev, NULL);
+    }
 
-static uint8_t blk_sz_cnt = 0;    // # of block sizes = # of pools
-static uint16_t* blk_szs;         // block_sizes array
-static uint8_t** pool_base_addrs; // base addresses of pools
-static uint8_t** blk_alloc;       // next block address to be allocated
+    uint8_t* tail = head;
+    while (BLK_LINK(tail) != NULL) {
+        tail = BLK_LINK(tail);
+    }
+    mag->cnts[pool] = keep;
 
-bool pool_init(const size_t* block_sizes, size_t block_size_count)
-{
-    /******* verify pool state and args *******/
+    blk_attach(mag->heap, pool, head, tail);
+}
 
-    /* verify pool not already init */
-    if (g_pool_heap_init) {
-#ifdef VERBOSE
-        printf("ERROR: pool already init\n");
-#endif
-        return false;
+/* Description: fill empty thread magazine, taking blocks freed remotely in bulk without the pool lock when there are any
+ * Args: mag - magazine
+ *       pool - pool index
+ * Return: void
+ */
+static void mag_refill(blk_mag_t* mag, uint8_t pool) {
+    pool_t* heap = mag->heap;
+    uint8_t* head = blk_remote_take(heap, pool);
+    if (head == NULL) {
+        uint32_t cnt = POOL_MAG_BATCH;
+        mag->blks[pool] = blk_detach(heap, pool, &cnt);
+        mag->cnts[pool] = cnt;
+        return;
     }
 
-    /* verify valid number of pools */ 
-    if (block_size_count < MIN_POOLS || block_size_count > MAX_POOLS) {
-#ifdef VERBOSE
-        printf("ERROR: invalid number of pools\n");
-#endif
-        return false;
+    /* cache at most what a magazine holds before flushing, so one thread cannot hoard the stack */
+    uint8_t* tail = head;
+    uint16_t cnt = 1;
+    while (cnt < 2 * POOL_MAG_BATCH - 1 && BLK_LINK(tail) != NULL) {
+        tail = BLK_LINK(tail);
+        cnt++;
     }
-    
-    /* verify valid block sizes array */
-    if (block_sizes == NULL) {
-#ifdef VERBOSE
-        printf("ERROR: invalid block_size array\n");
-#endif
-        return false;
+    uint8_t* rest = BLK_LINK(tail);
+    BLK_SET_LINK(tail, NULL);
+    mag->blks[pool] = head;
+    mag->cnts[pool] = cnt;
+
+    /* splice the rest onto shared free list for other threads */
+    if (rest != NULL) {
+        tail = rest;
+        while (BLK_LINK(tail) != NULL) {
+            tail = BLK_LINK(tail);
+        }
+        pthread_mutex_lock(&heap->pool_locks[pool].mtx);
+        BLK_SET_LINK(tail, heap->blk_alloc[pool]);
+        heap->blk_alloc[pool] = rest;
+        pthread_mutex_unlock(&heap->pool_locks[pool].mtx);
     }
+}
 
-    /* verify valid block sizes */
-    for (uint8_t i = 0; i < block_size_count; i++) {
-        if (block_sizes[i] < MIN_BLOCK_SIZE || block_sizes[i] > MAX_BLOCK_SIZE) {
-#ifdef VERBOSE
-            printf("ERROR: invalid block size\n");
-#endif
-            return false;
+/* Description: return all blocks cached by thread and release its magazines, registered as thread exit destructor
+ * Args: arg - unused
+ * Return: void
+ */
+static void mag_flush_all(void* arg) {
+    (void)arg;
+    for (uint8_t i = 0; i < POOL_MAG_HEAPS; i++) {
+        blk_mag_t* mag = &tls_mags.mags[i];
+        if (mag->heap != NULL && heap_valid(mag->heap) && mag->heap->id == mag->heap_id) {
+            for (uint8_t j = 0; j < mag->heap->blk_sz_cnt; j++) {
+                mag_flush(mag, j, 0);
+                blk_stat_add(mag->heap, j, &mag->stats[j]);
+            }
         }
+        *mag = (blk_mag_t){ 0 };
     }
+}
 
-    /******* init heap management data *******/
+static void mag_key_create(void) {
+    pthread_key_create(&mag_key, mag_flush_all);
+}
 
-    /* write block sizes into beginning of g_pool_heap */
-    uint8_t* brk = g_pool_heap;
-    blk_szs = (uint16_t*)brk;
-    blk_sz_cnt = block_size_count;
+void pool_thread_flush(void) {
+    mag_flush_all(NULL);
+}
 
-    for (uint8_t i = 0; i < blk_sz_cnt; i++) {
-        *((uint16_t*)brk) = (uint16_t)(block_sizes[i]);
-        brk += sizeof(uint16_t);
+static uint8_t* blk_pop(pool_t* heap, uint8_t pool) {
+    blk_mag_t* mag = mag_get(heap);
+
+    /* no magazine available, take block from shared free list */
+    if (mag == NULL) {
+        uint32_t cnt = 1;
+        return blk_detach(heap, pool, &cnt);
     }
 
-    /* reserve space for pool base address pointers */
-    pool_base_addrs = (uint8_t**)brk;
-    brk += blk_sz_cnt * sizeof(uint8_t*);
-    
-    /* reserve space for pool next block allocation address pointers */
-    blk_alloc = (uint8_t**)brk;
-    brk += blk_sz_cnt * sizeof(uint8_t*);
+    /* refill empty magazine from remote free stack or shared free list */
+    if (mag->blks[pool] == NULL) {
+        mag_refill(mag, pool);
+        if (mag->blks[pool] == NULL) {
+            return NULL;
+        }
+    }
 
-    /* compute bytes available after reserving heap memory management and find pool size */
-    uint16_t heap_mgmt_size = brk - g_pool_heap;
-    uint16_t bytes_free = sizeof(g_pool_heap) - heap_mgmt_size;
-    uint16_t pool_size = bytes_free / block_size_count;
-    uint16_t heap_remainder = bytes_free % blk_sz_cnt;
+    uint8_t* blk = mag->blks[pool];
+    mag->blks[pool] = BLK_LINK(blk);
+    mag->cnts[pool]--;
+    return blk;
+}
 
-    /* verify heap mgmnt + size of each pool * m pools + remainder (if any) == total heap size */
-    assert(sizeof(g_pool_heap) == (heap_mgmt_size + (pool_size * blk_sz_cnt) + heap_remainder));
+static void blk_push(pool_t* heap, uint8_t pool, uint8_t* blk) {
+    blk_mag_t* mag = mag_get(heap);
 
-#ifdef VERBOSE
-    printf("-- HEAP --\n");
-    printf("full heap size: %lu bytes\n", sizeof(g_pool_heap));
-    printf("heap mgmt size: %u bytes\n", heap_mgmt_size);
-    printf("heap pool size: %u bytes\n", bytes_free);
-    printf("each pool size: %u bytes\n", pool_size);
-    printf("heap remainder: %u bytes\n", heap_remainder);
-#endif
+    /* no magazine available, return block to remote free stack */
+    if (mag == NULL) {
+        blk_attach(heap, pool, blk, blk);
+        return;
+    }
 
-    /******* create pools and init blocks *******/
+    BLK_SET_LINK(blk, mag->blks[pool]);
+    mag->blks[pool] = blk;
+    mag->cnts[pool]++;
 
-    /* compute and assign pool_base_addrs */
-    /* note: on first itr, brk is after end of blk_alloc which is pool_base_addr[0] */
-    /* note: also init blk_alloc because the first blk of each pool init to pool_base_addr[i] */
-    for (uint8_t i = 0; i < blk_sz_cnt; i++) {
-        pool_base_addrs[i] = (uint8_t*)brk + (pool_size * i);
-        blk_alloc[i] = pool_base_addrs[i];
+    /* keep the hot half cached, return the rest once magazine holds two batches */
+    if (mag->cnts[pool] >= 2 * POOL_MAG_BATCH) {
+        mag_flush(mag, pool, POOL_MAG_BATCH);
     }
+}
 
-    /* calculate number of blocks that can fit in each pool, then init free list ptr links */
-    uint16_t blk_mem_req = 0;
-    uint16_t pool_blks = 0;
-    uint16_t bytes_remainder = 0;
-    for (uint8_t i = 0; i < blk_sz_cnt; i++) {
-        /* mem requirement for each block = sizeof(uint8_t*) + blk_szs[i] */
-        blk_mem_req = blk_szs[i] + sizeof(uint8_t*);
+static size_t blk_pop_batch(pool_t* heap, uint8_t pool, void** blks, size_t count) {
+    blk_mag_t* mag = mag_get(heap);
+    size_t got = 0;
 
-        pool_blks = pool_size / blk_mem_req; 
-        bytes_remainder = pool_size % blk_mem_req;
+    /* take cached blocks first, no lock needed */
+    while (mag != NULL && got < count && mag->blks[pool] != NULL) {
+        blks[got++] = mag->blks[pool];
+        mag->blks[pool] = BLK_LINK(mag->blks[pool]);
+        mag->cnts[pool]--;
+    }
 
-        /* verify number of blocks * block memory + remainder bytes == pool size */
-        assert(pool_size == (blk_mem_req * pool_blks + bytes_remainder));
+    /* detach the rest from shared free list under a single lock */
+    if (got < count) {
+        uint32_t cnt = (count - got > UINT32_MAX) ? UINT32_MAX : (uint32_t)(count - got);
+        uint8_t* blk = blk_detach(heap, pool, &cnt);
+        for (uint32_t i = 0; i < cnt; i++) {
+            blks[got++] = blk;
+            blk = BLK_LINK(blk);
+        }
+    }
+    return got;
+}
 
-#ifdef VERBOSE
-        printf("\n-- POOL[%d] --\n", i);
-        printf("blk_szs[%d]:  %d\n", i, blk_szs[i]);
-        printf("blk_mem_req: %d\n", blk_mem_req);
-        printf("pool_blks:   %d\n", pool_blks);
-        printf("bytes_rmdr:  %d\n", bytes_remainder);
-#endif
+#elif defined(POOL_LOCKFREE)
+static uint8_t* blk_head_load(pool_t* heap, uint8_t pool) {
+    return BLK_HEAD_BLK(heap, __atomic_load_n(&heap->blk_alloc[pool], __ATOMIC_ACQUIRE));
+}
 
-        /* init pointer at header of each block to 'next' block in order to create free list */
-        for (uint16_t j = 0; j < (pool_blks - 1); j++) {
+static uint8_t* blk_pop(pool_t* heap, uint8_t pool) {
+    blk_head_t head = __atomic_load_n(&heap->blk_alloc[pool], __ATOMIC_ACQUIRE);
+    blk_head_t next;
+    uint8_t* blk;
 
-            /* set current blk header = next blk addr */
-            *((uint8_t**)brk) = brk + sizeof(uint8_t*) + blk_szs[i];
+    do {
+        blk = BLK_HEAD_BLK(heap, head);
+        if (blk == NULL) {
+            return blk_carve(heap, pool);
+        }
+
+        /* note: blk may be popped and reused by another thread before CAS, then link is stale */
+        /* but CAS fails because generation changed, and heap memory is always readable */
+        uint8_t* blk_next = BLK_ENC(blk, __atomic_load_n((uint8_t**)blk, __ATOMIC_RELAXED));
+        next = BLK_HEAD_PACK(heap, BLK_HEAD_GEN(head) + 1, blk_next);
+    } while (!__atomic_compare_exchange_n(&heap->blk_alloc[pool], &head, next, true, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+
+    return blk;
+}
 
-            /* increment brk by total block mem requirement */
-            brk += sizeof(uint8_t*) + blk_szs[i];
+static void blk_push(pool_t* heap, uint8_t pool, uint8_t* blk) {
+    blk_attach(heap, pool, blk, blk);
+}
+
+static uint8_t* blk_detach(pool_t* heap, uint8_t pool, uint32_t* cnt) {
+    blk_head_t head = __atomic_load_n(&heap->blk_alloc[pool], __ATOMIC_ACQUIRE);
+    blk_head_t next;
+    uint8_t* first;
+    uint8_t* tail;
+    uint32_t max = *cnt;
+
+    do {
+        first = BLK_HEAD_BLK(heap, head);
+        if (first == NULL) {
+            *cnt = 0;
+            return NULL;
         }
 
-        /* set last block 'next' ptr to NULL */
-        *((uint8_t**)brk) = NULL;
-        brk += sizeof(uint8_t*) + blk_szs[i];
+        /* walk chain, links may be stale as in blk_pop, but a stale link may also be block data */
+        /* so only follow links within pools, anything else means head changed and CAS fails */
+        tail = first;
+        *cnt = 1;
+        uint8_t* blk_next = BLK_ENC(tail, __atomic_load_n((uint8_t**)tail, __ATOMIC_RELAXED));
+        while (*cnt < max && blk_next != NULL &&
+               blk_next >= heap->pool_base_addrs[0] && blk_next + sizeof(uint8_t*) <= heap->pool_max) {
+            tail = blk_next;
+            (*cnt)++;
+            blk_next = BLK_ENC(tail, __atomic_load_n((uint8_t**)tail, __ATOMIC_RELAXED));
+        }
+        next = BLK_HEAD_PACK(heap, BLK_HEAD_GEN(head) + 1, blk_next);
+    } while (!__atomic_compare_exchange_n(&heap->blk_alloc[pool], &head, next, true, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
 
-        /* add remaining bytes to get to next pool_base_addr */
-        brk += bytes_remainder;
-    }
+    /* detached chain is private to this thread now */
+    __atomic_store_n((uint8_t**)tail, BLK_ENC(tail, NULL), __ATOMIC_RELAXED);
+    return first;
+}
 
-    /* no byte left behind */
-    assert((brk + (bytes_free % block_size_count)) - g_pool_heap == sizeof(g_pool_heap));
+static void blk_attach(pool_t* heap, uint8_t pool, uint8_t* head, uint8_t* tail) {
+    blk_head_t old = __atomic_load_n(&heap->blk_alloc[pool], __ATOMIC_RELAXED);
+    blk_head_t next;
 
-    /* heap init complete */
-    g_pool_heap_init = true;
-    
-    return true;
+    do {
+        /* assign chain tail hdr ptr to current first in free list */
+        __atomic_store_n((uint8_t**)tail, BLK_ENC(tail, BLK_HEAD_BLK(heap, old)), __ATOMIC_RELAXED);
+        next = BLK_HEAD_PACK(heap, BLK_HEAD_GEN(old) + 1, head);
+    } while (!__atomic_compare_exchange_n(&heap->blk_alloc[pool], &old, next, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
 }
 
-void* pool_malloc(size_t n)
-{
-    /******* verify pool state and args *******/
+static void blk_empty(pool_t* heap, uint8_t pool) {
+    /* new generation, so a pop that read the old head fails its CAS */
+    blk_head_t old = __atomic_load_n(&heap->blk_alloc[pool], __ATOMIC_RELAXED);
+    __atomic_store_n(&heap->blk_alloc[pool], BLK_HEAD_PACK(heap, BLK_HEAD_GEN(old) + 1, NULL), __ATOMIC_RELEASE);
+}
+#elif defined(POOL_LOCALITY)
+/* page of block, pages are POOL_PAGE_SIZE aligned in address space so a page free list stays within one TLB page */
+#define BLK_PAGE(pages, blk) ((uint32_t)((size_t)((blk) - (pages)->page_min) / POOL_PAGE_SIZE))
 
-    /* verify pool already init */
-    if (!g_pool_heap_init) {
-#ifdef VERBOSE
-        printf("ERROR: pool not init\n");
+static void blk_pages_init(pool_t* heap, uint8_t pool) {
+    blk_pages_t* pages = &heap->blk_pages[pool];
+    uint8_t* blk_min = heap->pool_base_addrs[pool];
+    uint8_t* blk_max = blk_min + (heap->blk_cnts[pool] - 1) * heap->blk_mem_reqs[pool];
+
+    /* carved blocks are in address order, so pages fill from the lowest one up before any is freed */
+    /* note: heads are only read for pages set in map, they need no init */
+    pages->page_min = (uint8_t*)((uintptr_t)blk_min & ~(uintptr_t)(POOL_PAGE_SIZE - 1));
+    pages->page_cnt = BLK_PAGE(pages, blk_max) + 1;
+    blk_empty(heap, pool);
+}
+
+static uint32_t blk_page_next(const blk_pages_t* pages, uint32_t page) {
+    /* skip pages below page in its map word, then first set bit of following words */
+    size_t words = BLK_MAP_WORDS(pages->page_cnt);
+    size_t i = page / BLK_MAP_BITS;
+    uint64_t word = (i < words) ? pages->map[i] & (~(uint64_t)0 << (page % BLK_MAP_BITS)) : 0;
+    while (word == 0) {
+        if (++i >= words) {
+            return pages->page_cnt;
+        }
+        word = pages->map[i];
+    }
+    return i * BLK_MAP_BITS + __builtin_ctzll(word);
+}
+
+#ifdef POOL_PARANOID
+static uint8_t* blk_list_head(pool_t* heap, uint8_t pool, const uint8_t* blk) {
+    if (blk < heap->pool_base_addrs[0] || blk >= heap->pool_max) {
+        return heap->blk_alloc[pool];
+    }
+    blk_pages_t* pages = &heap->blk_pages[pool];
+    uint32_t page = BLK_PAGE(pages, blk);
+    return (BLK_MAP_WORD(pages->map, page) & BLK_MAP_MASK(page)) ? pages->heads[page] : NULL;
+}
 #endif
-        return NULL;
+
+static uint8_t* blk_pop(pool_t* heap, uint8_t pool) {
+    blk_pages_t* pages = &heap->blk_pages[pool];
+    uint8_t* blk;
+
+    /* untouched blocks above every page once pages are exhausted, slab blocks last */
+    if (pages->page_low == pages->page_cnt) {
+        blk = blk_carve(heap, pool);
+        if (blk == NULL && (blk = heap->blk_alloc[pool]) != NULL) {
+            heap->blk_alloc[pool] = BLK_LINK(blk);
+        }
+        return blk;
     }
 
-    /* verify selected block size is valid and if so, find index */
-    int8_t pool = -1;
-    for (uint8_t i = 0; i < blk_sz_cnt; i++) {
-        if (blk_szs[i] == n)
-            pool = i;
+    /* most recently freed block of lowest page with free blocks */
+    uint32_t page = pages->page_low;
+    blk = pages->heads[page];
+    pages->heads[page] = BLK_LINK(blk);
+
+    /* page exhausted, move on to next page with free blocks */
+    if (pages->heads[page] == NULL) {
+        BLK_MAP_WORD(pages->map, page) &= ~BLK_MAP_MASK(page);
+        pages->page_low = blk_page_next(pages, page);
     }
+    return blk;
+}
 
-    if (pool == -1) {
-#ifdef VERBOSE
-        printf("ERROR: invalid block size\n");
-#endif
-        return NULL;
+static void blk_push(pool_t* heap, uint8_t pool, uint8_t* blk) {
+    /* slab block, insert at front of slab free list */
+    if (blk < heap->pool_base_addrs[0] || blk >= heap->pool_max) {
+        BLK_SET_LINK(blk, heap->blk_alloc[pool]);
+        heap->blk_alloc[pool] = blk;
+        return;
     }
 
-    /* check if pool has available blocks */
-    if (blk_alloc[pool] == NULL) {
-#ifdef VERBOSE
-        printf("ERROR: no block available\n");
-#endif
-        return NULL;
+    /* insert at front of its page free list, page becomes lowest if below current */
+    /* note: head of a page without free blocks is stale, or unset until the page first has one */
+    blk_pages_t* pages = &heap->blk_pages[pool];
+    uint32_t page = BLK_PAGE(pages, blk);
+    BLK_SET_LINK(blk, (BLK_MAP_WORD(pages->map, page) & BLK_MAP_MASK(page)) ? pages->heads[page] : NULL);
+    pages->heads[page] = blk;
+    BLK_MAP_WORD(pages->map, page) |= BLK_MAP_MASK(page);
+    if (page < pages->page_low) {
+        pages->page_low = page;
     }
+}
 
-    /******* allocate block and identify next block to be allocated *******/
+static void blk_attach(pool_t* heap, uint8_t pool, uint8_t* head, uint8_t* tail) {
+    /* chain may span pages, sort each block into its own list - tail link is not read */
+    uint8_t* blk = head;
+    while (blk != tail) {
+        uint8_t* next = BLK_LINK(blk);
+        blk_push(heap, pool, blk);
+        blk = next;
+    }
+    blk_push(heap, pool, tail);
+}
 
-    /* allocate free block */
-    uint8_t* blk = blk_alloc[pool];
+static uint8_t* blk_detach(pool_t* heap, uint8_t pool, uint32_t* cnt) {
+    uint32_t max = *cnt;
+    uint8_t* head = NULL;
+    uint8_t* tail = NULL;
+    uint8_t* blk;
 
-    /* bump next blk alloc */
-    blk_alloc[pool] = *((uint8_t**)blk_alloc[pool]);
+    /* chain blocks in pop order, lowest pages first */
+    *cnt = 0;
+    while (*cnt < max && (blk = blk_pop(heap, pool)) != NULL) {
+        if (tail == NULL) {
+            head = blk;
+        }
+        else {
+            BLK_SET_LINK(tail, blk);
+        }
+        tail = blk;
+        (*cnt)++;
+    }
+    if (tail != NULL) {
+        BLK_SET_LINK(tail, NULL);
+    }
+    return head;
+}
 
-    /* convert block header ptr to block data ptr */
-    return (void*)blk_hdr_to_data(blk);
+static void blk_empty(pool_t* heap, uint8_t pool) {
+    blk_pages_t* pages = &heap->blk_pages[pool];
+    for (size_t i = 0; i < BLK_MAP_WORDS(pages->page_cnt); i++) {
+        pages->map[i] = 0;
+    }
+    pages->page_low = pages->page_cnt;
+    heap->blk_alloc[pool] = NULL;
 }
+#else
+static uint8_t* blk_pop(pool_t* heap, uint8_t pool) {
+    uint8_t* blk = heap->blk_alloc[pool];
 
-void pool_free(void* ptr)
-{
-    /******* verify pool state and args *******/
+    /* bump next blk alloc, list ran dry then carve an untouched block */
+    if (blk != NULL) {
+        heap->blk_alloc[pool] = BLK_LINK(blk);
+    }
+    else {
+        blk = blk_carve(heap, pool);
+    }
+    return blk;
+}
 
-    /* verify pool already init */
-    if (!g_pool_heap_init) {
-#ifdef VERBOSE
-        printf("ERROR: pool not init\n");
-#endif
+static void blk_push(pool_t* heap, uint8_t pool, uint8_t* blk) {
+#ifdef POOL_CHECKPOINTS
+    /* block handed out before innermost checkpoint is set aside with the outermost checkpoint it predates */
+    pool_checkpoint_t* cp = heap->ckpt;
+    uint32_t blk_idx = (cp != NULL) ? (uint32_t)((size_t)(blk - heap->pool_base_addrs[pool]) / heap->blk_mem_reqs[pool]) : 0;
+    if (cp != NULL && blk_idx < cp->marks[pool]) {
+        while (cp->prev != NULL && blk_idx < cp->prev->marks[pool]) {
+            cp = cp->prev;
+        }
+        BLK_SET_LINK(blk, cp->heads[pool]);
+        cp->heads[pool] = blk;
         return;
     }
-
-    /* verify pointer not NULL */
-    if (ptr == NULL) {
-#ifdef VERBOSE
-        printf("ERROR: cannot free NULL ptr\n");
 #endif
+
+    /* assign block hdr ptr to current first in free list */
+    BLK_SET_LINK(blk, heap->blk_alloc[pool]);
+
+    /* insert freed block at front of free list */
+    heap->blk_alloc[pool] = blk;
+}
+
+static void blk_attach(pool_t* heap, uint8_t pool, uint8_t* head, uint8_t* tail) {
+#ifdef POOL_CHECKPOINTS
+    /* chain may mix blocks from before and after checkpoints, sort each one - tail link is not read */
+    if (heap->ckpt != NULL) {
+        uint8_t* blk = head;
+        while (blk != tail) {
+            uint8_t* next = BLK_LINK(blk);
+            blk_push(heap, pool, blk);
+            blk = next;
+        }
+        blk_push(heap, pool, tail);
         return;
     }
+#endif
+
+    BLK_SET_LINK(tail, heap->blk_alloc[pool]);
+    heap->blk_alloc[pool] = head;
+}
+
+static uint8_t* blk_detach(pool_t* heap, uint8_t pool, uint32_t* cnt) {
+    uint32_t max = *cnt;
+    uint8_t* head = heap->blk_alloc[pool];
+    uint8_t* tail = head;
+
+    *cnt = 0;
+    if (head != NULL) {
+        *cnt = 1;
+        while (*cnt < max && BLK_LINK(tail) != NULL) {
+            tail = BLK_LINK(tail);
+            (*cnt)++;
+        }
+        heap->blk_alloc[pool] = BLK_LINK(tail);
+        BLK_SET_LINK(tail, NULL);
+    }
+    return head;
+}
+
+static void blk_empty(pool_t* heap, uint8_t pool) {
+    heap->blk_alloc[pool] = NULL;
+}
 
-    /* verify pointer within valid boundary pool_base_addr[0] and max_heap pointer */
-    if ((uint8_t*)ptr < pool_base_addrs[0] || (uint8_t*)ptr > g_pool_heap_max) {
-#ifdef VERBOSE
-        printf("ERROR: ptr not within valid heap boundaries\n");
 #endif
-        return;
+
+#ifndef POOL_CONCURRENT
+static size_t blk_pop_batch(pool_t* heap, uint8_t pool, void** blks, size_t count) {
+    uint32_t cnt = (count > UINT32_MAX) ? UINT32_MAX : (uint32_t)count;
+    uint8_t* blk = blk_detach(heap, pool, &cnt);
+    for (uint32_t i = 0; i < cnt; i++) {
+        blks[i] = blk;
+        blk = BLK_LINK(blk);
     }
 
-    /* find pool */
-    uint8_t pool = -1;
-    for (uint8_t i = 0; i < (blk_sz_cnt - 1); i++) {
-        if ((uint8_t*)ptr >= pool_base_addrs[i] && (uint8_t*)ptr <= pool_base_addrs[i+1]) {
-            pool = i;
-        }
-        else {
-            pool = i+1;
+    /* free list ran dry, carve the rest from the untouched end of the pool */
+    size_t got = cnt;
+    while (got < count && (blk = blk_carve(heap, pool)) != NULL) {
+        blks[got++] = blk;
+    }
+    return got;
+}
+#endif
+
+static uint8_t* blk_carve(pool_t* heap, uint8_t pool) {
+    uint32_t blk_idx = POOL_STAT_LOAD(BLK_CARVED(heap, pool));
+#ifdef POOL_THREADED
+    do {
+        if (blk_idx >= heap->blk_cnts[pool]) {
+            return NULL;
         }
+    } while (!__atomic_compare_exchange_n(&BLK_CARVED(heap, pool), &blk_idx, blk_idx + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+#else
+    if (blk_idx >= heap->blk_cnts[pool]) {
+        return NULL;
     }
+    BLK_CARVED(heap, pool) = blk_idx + 1;
+#endif
 
-    /* convert ptr from data to header */
-    uint8_t* hdr_ptr = blk_data_to_hdr((uint8_t*)ptr);
+    /* bit may be left set by a block allocated before a reset */
+    uint8_t* blk = heap->pool_base_addrs[pool] + (size_t)blk_idx * heap->blk_mem_reqs[pool];
+    blk_map_clear(heap->blk_maps[pool], blk_idx);
+#ifdef BLK_ANNOTATE
+    BLK_ACCESS(blk, heap->blk_mem_reqs[pool]);
+#endif
+#ifdef BLK_GUARDED
+    blk_guard_free(heap, pool, blk);
+#endif
+    return blk;
+}
 
-    /* verify ptr is aligned with blocks in pool otherwise invalid pointer */
-    if (((hdr_ptr - pool_base_addrs[pool]) % (blk_szs[pool] + sizeof(uint8_t*))) != 0) {
-#ifdef VERBOSE
-        printf("ERROR: unaligned block pointer\n");
+static inline uint8_t* blk_get(pool_t* heap, uint8_t pool) {
+    if (BLK_BMP_POOL(heap, pool)) {
+        void* blk = NULL;
+        blk_bmp_take(heap, pool, &blk, 1);
+        return (uint8_t*)blk;
+    }
+    return blk_pop(heap, pool);
+}
+
+static void blk_bmp_init(pool_t* heap, uint8_t pool) {
+    blk_bmp_t* bmp = &heap->blk_bmps[pool];
+    uint32_t blk_cnt = heap->blk_cnts[pool];
+    size_t words = BLK_MAP_WORDS(blk_cnt);
+
+    if (blk_cnt % BLK_MAP_BITS != 0) {
+        heap->blk_maps[pool][words - 1] |= ~(uint64_t)0 << (blk_cnt % BLK_MAP_BITS);
+    }
+    for (size_t i = 0; i < BLK_MAP_WORDS(words); i++) {
+        bmp->sums[i] = 0;
+    }
+    if (words % BLK_MAP_BITS != 0) {
+        bmp->sums[BLK_MAP_WORDS(words) - 1] |= ~(uint64_t)0 << (words % BLK_MAP_BITS);
+    }
+    bmp->low = 0;
+}
+
+static size_t blk_bmp_next(const uint64_t* sums, size_t words, size_t word) {
+    size_t sum_words = BLK_MAP_WORDS(words);
+    size_t i = word / BLK_MAP_BITS;
+    if (i >= sum_words) {
+        return words;
+    }
+
+    /* words below start in its summary word read as full */
+    uint64_t avail = ~blk_map_load(&sums[i]) & (~(uint64_t)0 << (word % BLK_MAP_BITS));
+    while (avail == 0) {
+        i++;
+#if defined(__AVX2__) && !defined(POOL_THREADED)
+        /* skip 4 full summary words (16384 full blocks) per compare */
+        const __m256i full4 = _mm256_set1_epi64x(-1);
+        while (i + 4 <= sum_words &&
+               _mm256_movemask_epi8(_mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i*)&sums[i]), full4)) == -1) {
+            i += 4;
+        }
+#elif defined(__SSE4_1__) && !defined(POOL_THREADED)
+        /* skip 2 full summary words (8192 full blocks) per compare */
+        const __m128i full2 = _mm_set1_epi64x(-1);
+        while (i + 2 <= sum_words &&
+               _mm_movemask_epi8(_mm_cmpeq_epi64(_mm_loadu_si128((const __m128i*)&sums[i]), full2)) == 0xFFFF) {
+            i += 2;
+        }
 #endif
-        return;
+        if (i >= sum_words) {
+            return words;
+        }
+        avail = ~blk_map_load(&sums[i]);
     }
+    return i * BLK_MAP_BITS + __builtin_ctzll(avail);
+}
 
-    /* verify block is not already freed by walking free list */
-    uint8_t* blk = NULL;
-    blk = blk_alloc[pool];
-    while (blk != NULL) {
-        if (blk == hdr_ptr) {
-#ifdef VERBOSE
-            printf("ERROR: block already free\n");
+static void blk_bmp_full(blk_bmp_t* bmp, uint64_t* map, size_t word) {
+#ifdef POOL_THREADED
+    /* a block freed since the word filled up must stay findable - seq_cst set then read here, */
+    /* seq_cst clear then read in blk_bmp_free, so either this sees the free or the free sees the summary bit */
+    __atomic_fetch_or(&BLK_MAP_WORD(bmp->sums, word), BLK_MAP_MASK(word), __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&map[word], __ATOMIC_SEQ_CST) != ~(uint64_t)0) {
+        blk_map_clear(bmp->sums, word);
+    }
+#else
+    (void)map;
+    blk_map_set(bmp->sums, word);
 #endif
-            return;
+}
+
+static size_t blk_bmp_take(pool_t* heap, uint8_t pool, void** blks, size_t count) {
+    blk_bmp_t* bmp = &heap->blk_bmps[pool];
+    uint64_t* map = heap->blk_maps[pool];
+    uint8_t* pool_base = heap->pool_base_addrs[pool];
+    size_t blk_mem_req = heap->blk_mem_reqs[pool];
+    size_t words = BLK_MAP_WORDS(heap->blk_cnts[pool]);
+    size_t start = POOL_STAT_LOAD(bmp->low);
+    size_t word = blk_bmp_next(bmp->sums, words, start);
+    size_t got = 0;
+
+    while (got < count) {
+        if (word >= words) {
+            /* hint may be stale with POOL_THREADED, search once from first word before giving up */
+            if (start == 0) {
+                break;
+            }
+            start = 0;
+            word = blk_bmp_next(bmp->sums, words, 0);
+            continue;
+        }
+
+        /* claim lowest free bits of word, as many as still needed, with a single read-modify-write */
+        uint64_t bits = blk_map_load(&map[word]);
+        uint64_t avail = ~bits;
+        uint64_t mask = 0;
+        for (size_t n = got; avail != 0 && n < count; n++) {
+            mask |= avail & (~avail + 1);
+            avail &= avail - 1;
+        }
+        if (mask != 0) {
+            uint64_t old = blk_map_claim(&map[word], mask);
+            bits = old | mask;
+            for (uint64_t claimed = mask & ~old; claimed != 0; claimed &= claimed - 1) {
+                blks[got++] = pool_base + (word * BLK_MAP_BITS + __builtin_ctzll(claimed)) * blk_mem_req;
+            }
+        }
+
+        /* word used up, continue at next word with free blocks, otherwise retry word lost to another thread */
+        if (bits == ~(uint64_t)0) {
+            blk_bmp_full(bmp, map, word);
+            word = blk_bmp_next(bmp->sums, words, word + 1);
         }
-        blk = *((uint8_t**)blk);
     }
 
-    /******* free block and add to front of block alloc list *******/
+    POOL_STAT_STORE(bmp->low, (word < words) ? word : words);
+    return got;
+}
 
-    /* assign block hdr ptr to current first in free list */
-    *((uint8_t**)hdr_ptr) = blk_alloc[pool];
+static void blk_bmp_free(pool_t* heap, uint8_t pool, uint8_t* blk) {
+    blk_bmp_t* bmp = &heap->blk_bmps[pool];
+    size_t word = (size_t)(blk - heap->pool_base_addrs[pool]) / heap->blk_mem_reqs[pool] / BLK_MAP_BITS;
 
-    /* insert freed block at front of free list */
-    blk_alloc[pool] = hdr_ptr;
+#ifdef POOL_THREADED
+    /* block bit already cleared by blk_unmark, see blk_bmp_full */
+    if ((__atomic_load_n(&BLK_MAP_WORD(bmp->sums, word), __ATOMIC_SEQ_CST) & BLK_MAP_MASK(word)) != 0) {
+        blk_map_clear(bmp->sums, word);
+    }
 
-    return;
+    /* lower search hint, losing a race only costs a search from first word */
+    size_t low = POOL_STAT_LOAD(bmp->low);
+    while (word < low && !__atomic_compare_exchange_n(&bmp->low, &low, word, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+#else
+    blk_map_clear(bmp->sums, word);
+    if (word < bmp->low) {
+        bmp->low = word;
+    }
+#endif
+}
+
+#ifdef POOL_THREADED
+static inline void blk_map_set(uint64_t* map, uint32_t blk) {
+    __atomic_fetch_or(&BLK_MAP_WORD(map, blk), BLK_MAP_MASK(blk), __ATOMIC_RELAXED);
+}
+
+static inline bool blk_map_clear(uint64_t* map, uint32_t blk) {
+    /* note: seq_cst so a freed bitmap pool block is published to its next owner and ordered before blk_bmp_free */
+    uint64_t word = __atomic_fetch_and(&BLK_MAP_WORD(map, blk), ~BLK_MAP_MASK(blk), __ATOMIC_SEQ_CST);
+    return (word & BLK_MAP_MASK(blk)) != 0;
+}
+
+static inline bool blk_map_test(const uint64_t* map, uint32_t blk) {
+    return (__atomic_load_n(&BLK_MAP_WORD(map, blk), __ATOMIC_RELAXED) & BLK_MAP_MASK(blk)) != 0;
+}
+
+static inline uint64_t blk_map_load(const uint64_t* word) {
+    return __atomic_load_n(word, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t blk_map_claim(uint64_t* word, uint64_t mask) {
+    return __atomic_fetch_or(word, mask, __ATOMIC_ACQUIRE);
+}
+#else
+static inline void blk_map_set(uint64_t* map, uint32_t blk) {
+    BLK_MAP_WORD(map, blk) |= BLK_MAP_MASK(blk);
+}
+
+static inline bool blk_map_clear(uint64_t* map, uint32_t blk) {
+    bool was_set = (BLK_MAP_WORD(map, blk) & BLK_MAP_MASK(blk)) != 0;
+    BLK_MAP_WORD(map, blk) &= ~BLK_MAP_MASK(blk);
+    return was_set;
+}
+
+static inline bool blk_map_test(const uint64_t* map, uint32_t blk) {
+    return (BLK_MAP_WORD(map, blk) & BLK_MAP_MASK(blk)) != 0;
+}
+
+static inline uint64_t blk_map_load(const uint64_t* word) {
+    return *word;
+}
+
+static inline uint64_t blk_map_claim(uint64_t* word, uint64_t mask) {
+    uint64_t old = *word;
+    *word = old | mask;
+    return old;
+}
+#endif
+
+static uint8_t pool_find(const pool_t* heap, const uint8_t* ptr) {
+    /* branchless binary search for last pool base <= ptr, pool_base_addrs ascending */
+    /* note: at most log2(MAX_POOLS) iterations regardless of ptr */
+    uint8_t** base = heap->pool_base_addrs;
+    uint8_t n = heap->blk_sz_cnt;
+    while (n > 1) {
+        uint8_t half = n / 2;
+        base = (base[half] <= ptr) ? base + half : base;
+        n -= half;
+    }
+    return (uint8_t)(base - heap->pool_base_addrs);
 }
 
 uint8_t* blk_hdr_to_data(uint8_t* ptr) {
-    return (ptr == NULL ? NULL : (ptr += sizeof(uint8_t*)));
+    return (ptr == NULL ? NULL : (ptr += BLK_HDR_SIZE));
 }
 
 uint8_t* blk_data_to_hdr(uint8_t* ptr) {
-    return (ptr == NULL ? NULL : (ptr -= sizeof(uint8_t*)));
+    return (ptr == NULL ? NULL : (ptr -= BLK_HDR_SIZE));
 }
 
-void heap_print() {
+void heap_print_from(pool_t* heap) {
+    if (!heap_valid(heap)) {
+        printf("ERROR: pool not init\n");
+        return;
+    }
+
     printf("+-----------------------------------------------------+\n");
     printf("|                  heap mgmt data                     |\n");
     printf("+-----------------------------------------------------+\n");
 
-    /* check that blk_szs array starts at heap start */
-    printf("blk_szs = g_pool_heap [%p == %p]\n", blk_szs, g_pool_heap);
+    /* check that instance starts at heap start */
+    printf("heap = heap start [%p == %p]\n", (void*)heap, heap->heap);
     printf("\n");
 
     /* print blk_szs address and value */
-    for (uint8_t i = 0; i < blk_sz_cnt; i++) {
+    for (uint8_t i = 0; i < heap->blk_sz_cnt; i++) {
         if (i == 0)
-            printf("blk_szs[%d]:         [addr: %p] [val: %d] \n", i, &blk_szs[i], blk_szs[i]);
+            printf("blk_szs[%d]:         [addr: %p] [val: %d] \n", i, &heap->blk_szs[i], heap->blk_szs[i]);
         else
-            printf("blk_szs[%d]:         [addr: %p] [val: %d] [delta addr: %ld]\n", i, &blk_szs[i], blk_szs[i], (uint64_t)&blk_szs[i] - (uint64_t)&blk_szs[i-1]);
+            printf("blk_szs[%d]:         [addr: %p] [val: %d] [delta addr: %ld]\n", i, &heap->blk_szs[i], heap->blk_szs[i], (uint64_t)&heap->blk_szs[i] - (uint64_t)&heap->blk_szs[i-1]);
     }
     printf("\n");
 
     /* print pool_base_addrs address and value */
-    for (uint8_t i = 0; i < blk_sz_cnt; i++) {
+    for (uint8_t i = 0; i < heap->blk_sz_cnt; i++) {
         if (i == 0)
-            printf("pool_base_addrs[%d]: [addr: %p] [val: %p]\n", i, &pool_base_addrs[i], pool_base_addrs[i]);
+            printf("pool_base_addrs[%d]: [addr: %p] [val: %p]\n", i, &heap->pool_base_addrs[i], heap->pool_base_addrs[i]);
         else
-            printf("pool_base_addrs[%d]: [addr: %p] [val: %p] [delta addr: %ld] [delta val: %ld]\n", i, &pool_base_addrs[i], pool_base_addrs[i], (uint64_t)&pool_base_addrs[i] - (uint64_t)&pool_base_addrs[i-1], (pool_base_addrs[i] - pool_base_addrs[i-1]));
+            printf("pool_base_addrs[%d]: [addr: %p] [val: %p] [delta addr: %ld] [delta val: %ld]\n", i, &heap->pool_base_addrs[i], heap->pool_base_addrs[i], (uint64_t)&heap->pool_base_addrs[i] - (uint64_t)&heap->pool_base_addrs[i-1], (heap->pool_base_addrs[i] - heap->pool_base_addrs[i-1]));
     }
     printf("\n");
 
     /* print blk_alloc address and value */
-    for (uint8_t i = 0; i < blk_sz_cnt; i++) {
+    for (uint8_t i = 0; i < heap->blk_sz_cnt; i++) {
         if (i == 0)
-            printf("blk_alloc[%d]:       [addr: %p] [val: %p]\n", i, &blk_alloc[i], blk_alloc[i]);
+            printf("blk_alloc[%d]:       [addr: %p] [val: %p]\n", i, &heap->blk_alloc[i], BLK_HEAD(heap, i));
         else
-            printf("blk_alloc[%d]:       [addr: %p] [val: %p] [delta addr: %ld] [delta val: %ld]\n", i, &blk_alloc[i], blk_alloc[i], (uint64_t)&blk_alloc[i] - (uint64_t)&blk_alloc[i-1], (blk_alloc[i] - blk_alloc[i-1]));
+            printf("blk_alloc[%d]:       [addr: %p] [val: %p] [delta addr: %ld] [delta val: %ld]\n", i, &heap->blk_alloc[i], BLK_HEAD(heap, i), (uint64_t)&heap->blk_alloc[i] - (uint64_t)&heap->blk_alloc[i-1], (BLK_HEAD(heap, i) - BLK_HEAD(heap, i-1)));
     }
     printf("\n");
 
     /* print heap header size */
-    printf("heap header size: %ld\n\n", pool_base_addrs[0] - g_pool_heap);
+    printf("heap header size: %ld\n", heap->pool_base_addrs[0] - heap->heap);
+    printf("slabs: %zu of %zu\n\n", heap->slab_cnt, (heap->slab_alloc != NULL) ? heap->slab_max : (size_t)0);
 
     printf("+-----------------------------------------------------+\n");
     printf("|                  pool block data                    |\n");
     printf("+-----------------------------------------------------+\n");
 
     /* traverse each pool list to find each block */
-    for (uint8_t i = 0; i < blk_sz_cnt; i++) {
-        pool_print(i);
+    for (uint8_t i = 0; i < heap->blk_sz_cnt; i++) {
+        pool_print_from(heap, i);
     }
 }
 
-void pool_print(uint8_t pool) {
+void pool_print_from(pool_t* heap, uint8_t pool) {
+    if (!heap_valid(heap) || pool >= heap->blk_sz_cnt) {
+        printf("ERROR: invalid pool\n");
+        return;
+    }
+
     /* traverse each pool list to find each block */
     uint8_t* blk = NULL;
     printf("------- POOL[%u] -------\n", pool);
-    printf("blk_szs[%d]:         [addr: %p] [val: %d] \n", pool, &blk_szs[pool], blk_szs[pool]);
-    printf("pool_base_addrs[%d]: [addr: %p] [val: %p]\n", pool, &pool_base_addrs[pool], pool_base_addrs[pool]);
-    printf("blk_alloc[%d]:       [addr: %p] [val: %p]\n", pool, &blk_alloc[pool], blk_alloc[pool]);
-    printf("block mem req: %ld\n", blk_szs[pool] + sizeof(uint8_t*));
-    blk = blk_alloc[pool];
+    printf("blk_szs[%d]:         [addr: %p] [val: %d] \n", pool, &heap->blk_szs[pool], heap->blk_szs[pool]);
+    printf("pool_base_addrs[%d]: [addr: %p] [val: %p]\n", pool, &heap->pool_base_addrs[pool], heap->pool_base_addrs[pool]);
+    printf("blk_alloc[%d]:       [addr: %p] [val: %p]\n", pool, &heap->blk_alloc[pool], BLK_HEAD(heap, pool));
+    printf("block mem req: %d\n", heap->blk_mem_reqs[pool]);
+    printf("block align: %d\n", heap->blk_aligns[pool]);
+    printf("blocks carved: %u of %u\n", (unsigned)POOL_STAT_LOAD(BLK_CARVED(heap, pool)), (unsigned)heap->blk_cnts[pool]);
+
+    pool_stats_t stats;
+    pool_get_stats_from(heap, pool, &stats);
+    printf("allocs: %lu frees: %lu failures: %lu in use: %lu high water: %lu free: %lu\n",
+           (unsigned long)stats.allocs, (unsigned long)stats.frees, (unsigned long)stats.failures,
+           (unsigned long)stats.in_use, (unsigned long)stats.high_water, (unsigned long)stats.free_blks);
+    blk = BLK_HEAD(heap, pool);
 
     printf("------- BLOCKS -------\n");
-    uint16_t blks = 0;
+    uint32_t blks = 0;
+    if (BLK_BMP_POOL(heap, pool)) {
+        /* no free list, free blocks in address order from bitmap */
+        printf("bitmap pool\n");
+        for (uint32_t i = 0; i < heap->blk_cnts[pool]; i++) {
+            if (!blk_map_test(heap->blk_maps[pool], i)) {
+                printf("blk[%u]: [addr: %p]\n", blks, heap->pool_base_addrs[pool] + (size_t)i * heap->blk_mem_reqs[pool]);
+                blks++;
+            }
+        }
+    }
+#ifdef POOL_LOCALITY
+    else {
+        /* page lists in allocation order, then slab list */
+        blk_pages_t* pages = &heap->blk_pages[pool];
+        for (uint32_t page = blk_page_next(pages, pages->page_low); page < pages->page_cnt; page = blk_page_next(pages, page + 1)) {
+            printf("page[%u]: [addr: %p]\n", page, pages->page_min + (size_t)page * POOL_PAGE_SIZE);
+            for (uint8_t* page_blk = pages->heads[page]; page_blk != NULL; page_blk = BLK_LINK(page_blk)) {
+                printf("blk[%u]: [addr: %p] [*blk[%u]: %p] [delta val: %ld]\n", blks, page_blk, blks, BLK_LINK(page_blk), BLK_LINK(page_blk) - page_blk);
+                blks++;
+            }
+        }
+    }
+#endif
     while (blk != NULL) {
-        printf("blk[%u]: [addr: %p] [*blk[%u]: %p] [delta val: %ld]\n", blks, blk, blks, *((uint8_t**)blk), *((uint8_t**)blk) - blk);
-        blk = *((uint8_t**)blk);
+        printf("blk[%u]: [addr: %p] [*blk[%u]: %p] [delta val: %ld]\n", blks, blk, blks, BLK_LINK(blk), BLK_LINK(blk) - blk);
+        blk = BLK_LINK(blk);
         blks++;
     }
     printf("\n");
 }
+
+void heap_print() {
+    heap_print_from(pool_local());
+}
+
+void pool_print(uint8_t pool) {
+    pool_print_from(pool_local(), pool);
+}
@@ -10,33 +10,525 @@
 #define __POOL_ALLOC_H__
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#ifdef POOL_TRACE
+#include <stdio.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 /* define constraints */
 #define MIN_POOLS 1
 #define MAX_POOLS 16
 #define MIN_BLOCK_SIZE 1
 #define MAX_BLOCK_SIZE 2048 
+#define MAX_BLOCK_ALIGN 4096
+
+/* size of default instance heap used by pool_init, set at build time */
+#ifndef POOL_HEAP_SIZE
+#define POOL_HEAP_SIZE 65536
+#endif
+
+/* default slab size and max slabs of growable instances */
+#ifndef POOL_SLAB_SIZE
+#define POOL_SLAB_SIZE 65536
+#endif
+
+#ifndef POOL_SLAB_MAX
+#define POOL_SLAB_MAX 64
+#endif
+
+/* bytes per page free list of POOL_LOCALITY, power of 2 */
+#ifndef POOL_PAGE_SIZE
+#define POOL_PAGE_SIZE 4096
+#endif
+
+/* max nodes of pool_init_numa, at most 64 */
+#ifndef POOL_NUMA_NODES
+#define POOL_NUMA_NODES 8
+#endif
+
+/* huge page size used by pool_map */
+#ifndef POOL_HUGE_PAGE
+#define POOL_HUGE_PAGE (2 * 1024 * 1024)
+#endif
+
+/* allocator instance, managing pools inside caller supplied memory */
+typedef struct pool pool_t;
+
+#ifdef POOL_BEST_FIT
+/* internal fragmentation counters of a pool, cumulative since pool init */
+typedef struct {
+    uint64_t allocs;      // allocations served by pool
+    uint64_t fallbacks;   // allocations served because smaller pools were exhausted
+    uint64_t req_bytes;   // bytes requested by allocations served
+    uint64_t waste_bytes; // block bytes left unused by allocations served
+} pool_frag_t;
+#endif
+
+#ifdef POOL_TRACE
+/* latency histogram buckets, bucket i counts ops taking [2^i, 2^(i+1)) ticks */
+/* note: bucket 0 also counts 0 ticks, last bucket counts everything longer */
+#define POOL_LAT_BUCKETS 32
+
+/* trace events */
+#define POOL_TRACE_ALLOC 0     // block ptr of n requested bytes allocated from pool
+#define POOL_TRACE_FREE 1      // block ptr freed to pool, n = pool block size
+#define POOL_TRACE_EXHAUSTED 2 // request of n bytes failed, pool selected for it was exhausted, ptr = NULL
+
+/* trace hook, called after the operation completes by the thread that performed it */
+typedef void (*pool_trace_t)(void* ctx, uint8_t event, uint8_t pool, void* ptr, size_t n);
+
+/* latency histograms of a pool, in ticks (TSC cycles on x86, ns elsewhere) */
+typedef struct {
+    uint64_t malloc_ticks[POOL_LAT_BUCKETS]; // single block allocations, including failed ones
+    uint64_t free_ticks[POOL_LAT_BUCKETS];   // pool_free calls
+} pool_lat_t;
+
+/* capture stream written by pool_capture: one header, then one record per trace event, native byte order */
+#define POOL_CAPTURE_MAGIC 0x43525450 // "PTRC"
+#define POOL_CAPTURE_VERSION 1
+
+typedef struct {
+    uint32_t magic;      // POOL_CAPTURE_MAGIC
+    uint16_t version;    // POOL_CAPTURE_VERSION
+    uint16_t rec_size;   // sizeof(pool_capture_rec_t)
+} pool_capture_hdr_t;
+
+typedef struct {
+    uint64_t ticks;      // tick count when op completed
+    uint64_t handle;     // block address, pairs a free with its alloc, 0 for exhaustion
+    uint32_t size;       // requested bytes, block size for frees
+    uint8_t op;          // POOL_TRACE_ALLOC, POOL_TRACE_FREE or POOL_TRACE_EXHAUSTED
+    uint8_t pool;        // pool index
+    uint16_t reserved;   // 0
+} pool_capture_rec_t;
+#endif
+
+/* upstream provider of slabs for pool growth, must return len aligned memory (len is a power of 2) */
+typedef void* (*pool_slab_alloc_t)(size_t len, void* ctx);
+typedef void (*pool_slab_free_t)(void* mem, size_t len, void* ctx);
+
+/* allocator instance config */
+typedef struct {
+    const size_t* block_sizes;    // block size of each pool
+    size_t block_size_count;      // number of pools
+    const uint32_t* weights;      // optional share of heap of each pool relative to the others, NULL = even split
+    const size_t* block_counts;   // optional exact number of blocks of each pool, 0 or NULL = use weight
+    const size_t* alignments;     // optional block data alignment of each pool, power of 2, 0 or NULL = natural
+    const bool* bitmaps;          // optional, true = pool finds free blocks in its bitmap, no per-block header or link, NULL = none
+
+    pool_slab_alloc_t slab_alloc; // optional, grow exhausted pools by a slab from this provider, NULL = fixed pools
+    pool_slab_free_t slab_free;   // optional, return slabs to provider, NULL = slabs kept until pool_destroy
+    void* slab_ctx;               // passed to slab_alloc / slab_free
+    size_t slab_size;             // bytes per slab, power of 2, 0 = POOL_SLAB_SIZE
+    size_t slab_max;              // max slabs of instance, 0 = POOL_SLAB_MAX
+    size_t slab_release;          // release an empty slab if pool keeps at least this many free blocks, 0 = never
+} pool_cfg_t;
+
+/* usage counters of a pool, see pool_get_stats */
+typedef struct {
+    uint64_t allocs;     // successful allocations
+    uint64_t frees;      // successful frees
+    uint64_t failures;   // allocations failed because pool was exhausted
+    uint64_t in_use;     // blocks currently allocated
+    uint64_t high_water; // most blocks allocated at once
+    uint64_t free_blks;  // blocks available, including slab blocks and blocks cached by threads
+#if defined(POOL_CANARY) || defined(POOL_POISON)
+    uint64_t faults;     // blocks found overflowed on free (canary) or written after free (poison), left allocated on overflow
+#endif
+} pool_stats_t;
+
+/* layout of a pool */
+typedef struct {
+    size_t blk_sz;       // block size
+    size_t blk_align;    // block data alignment
+    size_t blk_cnt;      // number of blocks
+    size_t pool_bytes;   // bytes of heap given to pool
+    size_t slack_bytes;  // bytes of pool too small to hold another block
+    size_t slab_cnt;     // number of slabs pool has grown by
+    size_t slab_blk_cnt; // number of blocks in those slabs
+    bool bitmap;         // free blocks found by bitmap search, see pool_cfg_t bitmaps
+} pool_info_t;
+
+#if !defined(POOL_CONCURRENT) && !defined(POOL_LOCKFREE) && !defined(POOL_LOCALITY)
+/* checkpoints need a single thread and one free list per pool */
+#ifndef POOL_CHECKPOINTS
+#define POOL_CHECKPOINTS
+#endif
+
+/* open checkpoint of an instance, see pool_checkpoint, caller memory must stay valid until pool_rollback */
+typedef struct pool_checkpoint {
+    pool_t* heap;                 // instance
+    struct pool_checkpoint* prev; // enclosing open checkpoint, NULL if outermost
+    void* heads[MAX_POOLS];       // free list of each pool set aside, plus blocks older than marks freed while open
+    uint32_t marks[MAX_POOLS];    // # of blocks of each pool handed out since init or reset when checkpoint was taken
+} pool_checkpoint_t;
+#elif defined(POOL_CHECKPOINTS)
+#error "POOL_CHECKPOINTS needs a single thread and one free list per pool, not POOL_CONCURRENT, POOL_LOCKFREE or POOL_LOCALITY"
+#endif
+
+/* Description: create allocator instance in caller supplied memory
+ *              (instance and heap mgmt data are stored at start of mem, blocks are not touched until first handed out)
+ * Args: mem - memory to manage (POOL_LOCKFREE: up to 4GB)
+ *       len - size of mem in bytes
+ *       block_sizes - array containing block size of each pool
+ *       block_size_count - number of pools
+ * Return: instance on success, NULL on failure
+ */
+pool_t* pool_create(void* mem, size_t len, const size_t* block_sizes, size_t block_size_count);
+
+/* Description: create allocator instance in caller supplied memory with per-pool sizing
+ *              (pools with block counts are sized exactly, the rest split remaining bytes by weight)
+ * Args: mem - memory to manage (POOL_LOCKFREE: up to 4GB)
+ *       len - size of mem in bytes
+ *       cfg - instance config
+ * Return: instance on success, NULL on failure
+ */
+pool_t* pool_create_cfg(void* mem, size_t len, const pool_cfg_t* cfg);
+
+/* Description: get layout of a pool
+ * Args: heap - instance
+ *       pool - pool index
+ *       info - layout copied here
+ * Return: true on success, false on failure
+ */
+bool pool_get_info_from(pool_t* heap, uint8_t pool, pool_info_t* info);
+
+/* Description: get layout of a default instance pool
+ * Args: pool - pool index
+ *       info - layout copied here
+ * Return: true on success, false on failure
+ */
+bool pool_get_info(uint8_t pool, pool_info_t* info);
+
+/* Description: destroy allocator instance, mem belongs to caller again and slabs are returned to provider
+ *              (with POOL_CONCURRENT, threads that used the instance must call pool_thread_flush first)
+ * Args: heap - instance
+ * Return: void
+ */
+void pool_destroy(pool_t* heap);
+
+/* Description: map memory for an instance from the OS
+ * Args: len - bytes requested, updated with bytes actually mapped
+ *       huge - back with huge pages: MAP_HUGETLB if reserved, else huge page aligned with THP madvise
+ * Return: mapped memory on success, NULL on failure (or if not supported)
+ */
+void* pool_map(size_t* len, bool huge);
+
+/* Description: unmap memory returned by pool_map
+ * Args: mem - mapped memory
+ *       len - mapped length as returned by pool_map
+ * Return: void
+ */
+void pool_unmap(void* mem, size_t len);
+
+/* Description: slab provider backed by mmap, for pool_cfg_t slab_alloc
+ * Args: len - slab size, power of 2
+ *       ctx - unused
+ * Return: len aligned slab on success, NULL on failure
+ */
+void* pool_slab_map(size_t len, void* ctx);
+
+/* Description: release slab from pool_slab_map, for pool_cfg_t slab_free
+ * Args: mem - slab
+ *       len - slab size
+ *       ctx - unused
+ * Return: void
+ */
+void pool_slab_unmap(void* mem, size_t len, void* ctx);
+
+/* Description: allocate n bytes from instance
+ * Args: heap - instance
+ *       n - size of memory to be allocated
+ * Return: pointer to allocated memory on success, NULL on failure
+ */
+void* pool_malloc_from(pool_t* heap, size_t n);
+
+/* Description: free allocated block to instance
+ * Args: heap - instance
+ *       ptr - pointer to block to be freed
+ * Return: void
+ */
+void pool_free_from(pool_t* heap, void* ptr);
+
+/* Description: allocate count blocks of n bytes from instance, detaching them from the free list at once
+ * Args: heap - instance
+ *       n - size of memory to be allocated
+ *       out - pointers to allocated memory written here
+ *       count - number of blocks
+ * Return: number of blocks allocated, less than count if pool exhausted
+ */
+size_t pool_malloc_batch_from(pool_t* heap, size_t n, void** out, size_t count);
+
+/* Description: free count allocated blocks to instance, splicing them onto the free list at once
+ * Args: heap - instance
+ *       ptrs - pointers to blocks to be freed, invalid pointers are skipped
+ *       count - number of blocks
+ * Return: void
+ */
+void pool_free_batch_from(pool_t* heap, void** ptrs, size_t count);
+
+/* Description: allocate n bytes aligned to align from instance
+ * Args: heap - instance
+ *       n - size of memory to be allocated
+ *       align - required alignment, power of 2
+ * Return: pointer to allocated memory on success, NULL if no pool of that size guarantees align
+ */
+void* pool_malloc_aligned_from(pool_t* heap, size_t n, size_t align);
 
-/* Description: initialize pool allocator
+/* Description: initialize default pool allocator instance
  * Args: block_sizes - array containing block size of each pool
  *       block_size_count - number of pools
  * Return: true on success, false on failure
  */
 bool pool_init(const size_t* block_sizes, size_t block_size_count);
 
+/* Description: initialize default pool allocator instance with pool config
+ * Args: cfg - pool config
+ * Return: true on success, false on failure
+ */
+bool pool_init_cfg(const pool_cfg_t* cfg);
+
+#ifdef POOL_NUMA
+/* Description: initialize default allocator as one instance per NUMA node, each on a POOL_HEAP_SIZE heap
+ *              mapped with pool_map and bound to its node with mbind before first touch
+ *              (pool_malloc then serves the calling thread's node, pool_free returns blocks to their home node,
+ *               other default instance calls act on the calling thread's node)
+ * Args: cfg - pool config of every node
+ *       node_cnt - # of nodes, 0 = up to highest online node, nodes not online (gaps or simulated) are left unbound
+ * Return: true on success, false on failure (including a failed bind of an online node)
+ */
+bool pool_init_numa(const pool_cfg_t* cfg, uint8_t node_cnt);
+
+/* Description: set node of calling thread's default instance, e.g. to pin a thread or simulate nodes
+ * Args: node - node index (taken modulo node count), -1 = detect from the cpu the thread runs on
+ * Return: void
+ */
+void pool_numa_set_node(int node);
+
+/* Description: get default instance of a node, for the _from calls
+ * Args: node - node index
+ * Return: instance of node, NULL if pool_init_numa did not create it
+ */
+pool_t* pool_numa_heap(uint8_t node);
+#endif
+
 /* Description: allocate n bytes
  * Args: n - size of memory to be allocated
  * Return: pointer to allocated memory on success, NULL on failure
  */
 void* pool_malloc(size_t n);
 
+/* Description: allocate count blocks of n bytes
+ * Args: n - size of memory to be allocated
+ *       out - pointers to allocated memory written here
+ *       count - number of blocks
+ * Return: number of blocks allocated, less than count if pool exhausted
+ */
+size_t pool_malloc_batch(size_t n, void** out, size_t count);
+
+/* Description: free count allocated blocks
+ * Args: ptrs - pointers to blocks to be freed, invalid pointers are skipped
+ *       count - number of blocks
+ * Return: void
+ */
+void pool_free_batch(void** ptrs, size_t count);
+
+/* Description: allocate n bytes aligned to align
+ * Args: n - size of memory to be allocated
+ *       align - required alignment, power of 2
+ * Return: pointer to allocated memory on success, NULL if no pool of that size guarantees align
+ */
+void* pool_malloc_aligned(size_t n, size_t align);
+
 /* Description: free allocated block 
  * Args: ptr - pointer to block to be freed
  * Return: void
  */
 void pool_free(void* ptr);
 
+/* Description: check whether ptr lies in memory managed by instance (main heap or a slab), O(log slabs)
+ *              (address check only, lets callers route frees of mixed origin)
+ * Args: heap - instance
+ *       ptr - address
+ * Return: true if ptr is within instance pools
+ */
+bool pool_owns_from(pool_t* heap, const void* ptr);
+
+/* Description: check whether ptr lies in memory managed by default instance
+ * Args: ptr - address
+ * Return: true if ptr is within default instance pools
+ */
+bool pool_owns(const void* ptr);
+
+/* Description: free every block of a pool at once, O(1) for free list pools without slabs
+ *              (blocks are handed out again from the start of the pool, slabs are returned to provider if it takes them,
+ *               open checkpoints are closed and their set aside free blocks rejoin the pools, with POOL_CONCURRENT other threads must call pool_thread_flush first)
+ * Args: heap - instance
+ *       pool - pool index
+ * Return: true on success, false on failure
+ */
+bool pool_reset_from(pool_t* heap, uint8_t pool);
+
+/* Description: free every block of every pool of instance at once, see pool_reset_from
+ * Args: heap - instance
+ * Return: true on success, false on failure
+ */
+bool pool_reset_all_from(pool_t* heap);
+
+/* Description: free every block of a default instance pool at once, see pool_reset_from
+ * Args: pool - pool index
+ * Return: true on success, false on failure
+ */
+bool pool_reset(uint8_t pool);
+
+/* Description: free every block of every default instance pool at once, see pool_reset_from
+ * Args: void
+ * Return: true on success, false on failure
+ */
+bool pool_reset_all(void);
+
+#ifdef POOL_CHECKPOINTS
+/* Description: open a checkpoint, pool_rollback then frees every block allocated after it in O(pools + blocks freed since)
+ *              (blocks handed out before it are set aside once free, so allocations only take blocks carved or freed in scope,
+ *               checkpoints nest and are rolled back innermost first, instances with growth or bitmap pools have none)
+ * Args: heap - instance
+ *       cp - checkpoint written here
+ * Return: true on success, false on failure
+ */
+bool pool_checkpoint_from(pool_t* heap, pool_checkpoint_t* cp);
+
+/* Description: open a checkpoint of default instance, see pool_checkpoint_from
+ * Args: cp - checkpoint written here
+ * Return: true on success, false on failure
+ */
+bool pool_checkpoint(pool_checkpoint_t* cp);
+
+/* Description: free every block allocated since checkpoint and close it, blocks allocated before stay allocated
+ * Args: cp - innermost open checkpoint of its instance
+ * Return: true on success, false if cp is not the innermost open checkpoint
+ */
+bool pool_rollback(pool_checkpoint_t* cp);
+#endif
+
+#ifdef POOL_CONCURRENT
+/* Description: return blocks cached by calling thread to shared pool free lists of all instances
+ *              (done automatically on thread exit)
+ * Args: void
+ * Return: void
+ */
+void pool_thread_flush(void);
+#endif
+
+/* Description: get usage counters of a pool, O(1) snapshot
+ *              (with POOL_CONCURRENT, other threads' counts may lag by up to POOL_MAG_BATCH ops per pool)
+ * Args: heap - instance
+ *       pool - pool index
+ *       stats - counters copied here
+ * Return: true on success, false on failure
+ */
+bool pool_get_stats_from(pool_t* heap, uint8_t pool, pool_stats_t* stats);
+
+/* Description: get usage counters of a default instance pool
+ * Args: pool - pool index
+ *       stats - counters copied here
+ * Return: true on success, false on failure
+ */
+bool pool_get_stats(uint8_t pool, pool_stats_t* stats);
+
+#ifdef POOL_BEST_FIT
+/* Description: get internal fragmentation counters of a pool (POOL_BEST_FIT only)
+ * Args: heap - instance
+ *       pool - pool index
+ *       frag - counters copied here
+ * Return: true on success, false on failure
+ */
+bool pool_get_frag_from(pool_t* heap, uint8_t pool, pool_frag_t* frag);
+
+/* Description: get internal fragmentation counters of a default instance pool (POOL_BEST_FIT only)
+ * Args: pool - pool index
+ *       frag - counters copied here
+ * Return: true on success, false on failure
+ */
+bool pool_get_frag(uint8_t pool, pool_frag_t* frag);
+#endif
+
+#ifdef POOL_TRACE
+/* Description: register trace hook of instance (POOL_TRACE only), set before other threads use it
+ * Args: heap - instance
+ *       trace - hook called on every alloc, free and exhaustion, NULL = no hook
+ *       ctx - passed to trace
+ * Return: true on success, false on failure
+ */
+bool pool_set_trace_from(pool_t* heap, pool_trace_t trace, void* ctx);
+
+/* Description: register trace hook of default instance (POOL_TRACE only)
+ * Args: trace - hook called on every alloc, free and exhaustion, NULL = no hook
+ *       ctx - passed to trace
+ * Return: true on success, false on failure
+ */
+bool pool_set_trace(pool_trace_t trace, void* ctx);
+
+/* Description: trace hook writing a pool_capture_rec_t per event (POOL_TRACE only)
+ * Args: ctx - FILE* the stream is written to
+ *       event - trace event
+ *       pool - pool index
+ *       ptr - block ptr
+ *       n - size
+ * Return: void
+ */
+void pool_capture(void* ctx, uint8_t event, uint8_t pool, void* ptr, size_t n);
+
+/* Description: write capture header to out and register pool_capture as trace hook of instance (POOL_TRACE only),
+ *              stop with pool_set_trace_from(heap, NULL, NULL) before closing out
+ * Args: heap - instance
+ *       out - binary stream
+ * Return: true on success, false on failure
+ */
+bool pool_capture_start_from(pool_t* heap, FILE* out);
+
+/* Description: start capture of default instance (POOL_TRACE only)
+ * Args: out - binary stream
+ * Return: true on success, false on failure
+ */
+bool pool_capture_start(FILE* out);
+
+/* Description: start recording latency histograms of instance in caller memory (POOL_TRACE only),
+ *              set before other threads use it
+ * Args: heap - instance
+ *       lats - one histogram per pool, zeroed here, NULL = stop recording
+ * Return: true on success, false on failure
+ */
+bool pool_set_lat_from(pool_t* heap, pool_lat_t* lats);
+
+/* Description: start recording latency histograms of default instance (POOL_TRACE only)
+ * Args: lats - one histogram per pool, zeroed here, NULL = stop recording
+ * Return: true on success, false on failure
+ */
+bool pool_set_lat(pool_lat_t* lats);
+
+/* Description: get latency histograms of a pool (POOL_TRACE only)
+ * Args: heap - instance
+ *       pool - pool index
+ *       lat - histograms copied here
+ * Return: true on success, false on failure or if not recording
+ */
+bool pool_get_lat_from(pool_t* heap, uint8_t pool, pool_lat_t* lat);
+
+/* Description: get latency histograms of a default instance pool (POOL_TRACE only)
+ * Args: pool - pool index
+ *       lat - histograms copied here
+ * Return: true on success, false on failure or if not recording
+ */
+bool pool_get_lat(uint8_t pool, pool_lat_t* lat);
+#endif
+
 /* Description: convert pointer to block header to pointer to block data section 
+ *              (with POOL_HEADERLESS blocks have no header, both pointers are equal, as in bitmap pools)
  * Args: ptr - pointer to block header
  * Return: ptr to block data section 
  */
@@ -48,6 +540,19 @@ uint8_t* blk_hdr_to_data(uint8_t* ptr);
  */
 uint8_t* blk_data_to_hdr(uint8_t* ptr);
 
+/* Description: print heap mgmt data and all pools of instance
+ * Args: heap - instance
+ * Return: void
+ */
+void heap_print_from(pool_t* heap);
+
+/* Description: print info and blocks for a given pool of instance
+ * Args: heap - instance
+ *       pool - pool index
+ * Return: void
+ */
+void pool_print_from(pool_t* heap, uint8_t pool);
+
 /* Description: print heap mgmt data and all pools
  * Args: void
  * Return: void
@@ -60,4 +565,8 @@ void heap_print(void);
  */
 void pool_print(uint8_t pool);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif // __POOL_ALLOC_H__
@@ -0,0 +1,440 @@
+/*****************************************************
+ *
+ * Author: Michael Adams
+ *
+ * Description: header-only C++ front ends - allocator with
+ *              pool layout fixed at compile time, and STL
+ *              adaptors and typed pools over a C instance
+ *
+ ****************************************************/
+
+#ifndef __POOL_ALLOC_HPP__
+#define __POOL_ALLOC_HPP__
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <new>
+#include <utility>
+
+#include "pool_alloc.h"
+
+/* Description: block pool allocator over HeapSize bytes it holds itself, one pool per block size in Sizes
+ *              (size to pool mapping, block strides and pool offsets are compile time constants,
+ *              so allocating a known size is a single free list pop, not thread safe)
+ * Args: HeapSize - bytes split evenly between pools
+ *       Sizes - ascending block sizes, MIN_BLOCK_SIZE..MAX_BLOCK_SIZE
+ */
+template <std::size_t HeapSize, std::size_t... Sizes>
+class basic_pool_alloc {
+public:
+    static constexpr std::size_t pool_cnt = sizeof...(Sizes);
+    static constexpr std::uint8_t pool_none = 0xFF;
+
+    static_assert(pool_cnt >= MIN_POOLS && pool_cnt <= MAX_POOLS, "pool count must be MIN_POOLS..MAX_POOLS");
+
+private:
+    static constexpr std::size_t blk_szs[pool_cnt] = { Sizes... };
+
+    /* pools start on max_align_t boundaries so block alignment only depends on stride */
+    static constexpr std::size_t heap_align = alignof(std::max_align_t);
+
+    static constexpr bool sizes_valid() {
+        for (std::size_t i = 0; i < pool_cnt; i++) {
+            if (blk_szs[i] < MIN_BLOCK_SIZE || blk_szs[i] > MAX_BLOCK_SIZE || (i > 0 && blk_szs[i] <= blk_szs[i - 1])) {
+                return false;
+            }
+        }
+        return true;
+    }
+    static_assert(sizes_valid(), "block sizes must be ascending and MIN_BLOCK_SIZE..MAX_BLOCK_SIZE");
+
+public:
+    /* Description: pool serving n bytes, the one with the smallest block size >= n
+     * Args: n - requested size
+     * Return: pool index, pool_none if no pool holds n bytes
+     */
+    static constexpr std::uint8_t pool_of(std::size_t n) {
+        for (std::size_t i = 0; i < pool_cnt; i++) {
+            if (n >= MIN_BLOCK_SIZE && blk_szs[i] >= n) {
+                return static_cast<std::uint8_t>(i);
+            }
+        }
+        return pool_none;
+    }
+
+    static constexpr std::size_t blk_sz(std::uint8_t pool) { return blk_szs[pool]; }
+
+    /* Description: distance between blocks of pool, holds the free list link of a free block
+     * Args: pool - pool index
+     * Return: block stride in bytes, multiple of sizeof(void*)
+     */
+    static constexpr std::size_t blk_stride(std::uint8_t pool) {
+        return (blk_szs[pool] + sizeof(void*) - 1) / sizeof(void*) * sizeof(void*);
+    }
+
+    /* Description: alignment of every block of pool, lowest set bit of stride up to max_align_t
+     * Args: pool - pool index
+     * Return: block alignment in bytes
+     */
+    static constexpr std::size_t blk_align(std::uint8_t pool) {
+        std::size_t align = blk_stride(pool) & (~blk_stride(pool) + 1);
+        return (align < heap_align) ? align : heap_align;
+    }
+
+    /* bytes of heap given to each pool, even split like pool_init */
+    static constexpr std::size_t pool_share = HeapSize / pool_cnt / heap_align * heap_align;
+
+    static constexpr std::size_t pool_offset(std::uint8_t pool) { return pool * pool_share; }
+    static constexpr std::size_t blk_cnt(std::uint8_t pool) { return pool_share / blk_stride(pool); }
+
+private:
+    static constexpr bool pools_valid() {
+        for (std::size_t i = 0; i < pool_cnt; i++) {
+            if (blk_cnt(static_cast<std::uint8_t>(i)) == 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+    static_assert(pools_valid(), "heap too small, every pool needs at least one block");
+
+    /* pool index for each size 0..MAX_BLOCK_SIZE, for requests sized at runtime */
+    static constexpr std::array<std::uint8_t, MAX_BLOCK_SIZE + 1> make_blk_pools() {
+        std::array<std::uint8_t, MAX_BLOCK_SIZE + 1> pools{};
+        for (std::size_t n = 0; n <= MAX_BLOCK_SIZE; n++) {
+            pools[n] = pool_of(n);
+        }
+        return pools;
+    }
+    static constexpr std::array<std::uint8_t, MAX_BLOCK_SIZE + 1> blk_pools = make_blk_pools();
+
+public:
+    /* Description: thread free list of every pool through its blocks in address order
+     * Args: none
+     */
+    basic_pool_alloc() noexcept {
+        for (std::uint8_t i = 0; i < pool_cnt; i++) {
+            unsigned char* blk = heap_ + pool_offset(i);
+            blk_alloc_[i] = blk;
+            for (std::size_t j = 1; j < blk_cnt(i); j++) {
+                *reinterpret_cast<void**>(blk) = blk + blk_stride(i);
+                blk += blk_stride(i);
+            }
+            *reinterpret_cast<void**>(blk) = nullptr;
+        }
+    }
+
+    /* free lists point into the object itself */
+    basic_pool_alloc(const basic_pool_alloc&) = delete;
+    basic_pool_alloc& operator=(const basic_pool_alloc&) = delete;
+
+    /* Description: allocate a block of N bytes, pool resolved at compile time
+     * Args: N - size
+     * Return: ptr to block, nullptr if pool exhausted
+     */
+    template <std::size_t N>
+    void* allocate() noexcept {
+        constexpr std::uint8_t pool = pool_of(N);
+        static_assert(pool != pool_none, "no pool holds N bytes");
+        return blk_pop(pool);
+    }
+
+    /* Description: allocate uninitialized storage for a T, pool resolved at compile time
+     * Args: T - type
+     * Return: ptr to storage, nullptr if pool exhausted
+     */
+    template <class T>
+    T* allocate() noexcept {
+        static_assert(pool_of(sizeof(T)) != pool_none, "no pool holds a T");
+        static_assert(alignof(T) <= blk_align(pool_of(sizeof(T))), "pool blocks not aligned for T");
+        return static_cast<T*>(allocate<sizeof(T)>());
+    }
+
+    /* Description: allocate a block of n bytes, pool looked up in a table
+     * Args: n - size
+     * Return: ptr to block, nullptr if no pool holds n bytes or pool exhausted
+     */
+    void* allocate(std::size_t n) noexcept {
+        if (n > MAX_BLOCK_SIZE || blk_pools[n] == pool_none) {
+            return nullptr;
+        }
+        return blk_pop(blk_pools[n]);
+    }
+
+    /* Description: free a block allocated with N bytes, pool resolved at compile time
+     * Args: N - size
+     *       ptr - block, nullptr ignored
+     * Return: void
+     */
+    template <std::size_t N>
+    void deallocate(void* ptr) noexcept {
+        constexpr std::uint8_t pool = pool_of(N);
+        static_assert(pool != pool_none, "no pool holds N bytes");
+        blk_push(pool, ptr);
+    }
+
+    template <class T>
+    void deallocate(T* ptr) noexcept {
+        deallocate<sizeof(T)>(static_cast<void*>(ptr));
+    }
+
+    /* Description: free a block of any pool, pool found from address (equal shares, so a division)
+     * Args: ptr - block, nullptr ignored
+     * Return: void
+     */
+    void deallocate(void* ptr) noexcept {
+        if (ptr == nullptr) {
+            return;
+        }
+        assert(owns(ptr));
+        blk_push(static_cast<std::uint8_t>((static_cast<unsigned char*>(ptr) - heap_) / pool_share), ptr);
+    }
+
+    /* Description: check ptr is a block of this allocator
+     * Args: ptr - address
+     * Return: true if ptr is the start of a block
+     */
+    bool owns(const void* ptr) const noexcept {
+        const unsigned char* p = static_cast<const unsigned char*>(ptr);
+        if (p < heap_ || p >= heap_ + pool_cnt * pool_share) {
+            return false;
+        }
+        std::size_t off = static_cast<std::size_t>(p - heap_);
+        std::uint8_t pool = static_cast<std::uint8_t>(off / pool_share);
+        off -= pool_offset(pool);
+        return off % blk_stride(pool) == 0 && off / blk_stride(pool) < blk_cnt(pool);
+    }
+
+    /* Description: count free blocks of pool by walking its free list, O(free blocks)
+     * Args: pool - pool index
+     * Return: # of free blocks
+     */
+    std::size_t free_cnt(std::uint8_t pool) const noexcept {
+        std::size_t cnt = 0;
+        for (void* blk = blk_alloc_[pool]; blk != nullptr; blk = *static_cast<void**>(blk)) {
+            cnt++;
+        }
+        return cnt;
+    }
+
+private:
+    void* blk_pop(std::uint8_t pool) noexcept {
+        void* blk = blk_alloc_[pool];
+        if (blk != nullptr) {
+            blk_alloc_[pool] = *static_cast<void**>(blk);
+        }
+        return blk;
+    }
+
+    void blk_push(std::uint8_t pool, void* blk) noexcept {
+        if (blk == nullptr) {
+            return;
+        }
+        assert(owns(blk) && static_cast<std::size_t>(static_cast<unsigned char*>(blk) - heap_) / pool_share == pool);
+        *static_cast<void**>(blk) = blk_alloc_[pool];
+        blk_alloc_[pool] = blk;
+    }
+
+    alignas(heap_align) unsigned char heap_[HeapSize]; // pools, pool i at pool_offset(i)
+    void* blk_alloc_[pool_cnt];                        // first free block of each pool, nullptr if exhausted
+};
+
+/* allocator over a heap the size of the default C instance */
+template <std::size_t... Sizes>
+using pool_alloc = basic_pool_alloc<POOL_HEAP_SIZE, Sizes...>;
+
+/* Description: allocate n bytes aligned to align from instance, nullptr heap = default instance
+ * Args: heap - instance
+ *       n - size
+ *       align - alignment, power of 2
+ * Return: ptr to block, nullptr if no pool serves n bytes at align or pool exhausted
+ */
+inline void* pool_block_alloc(pool_t* heap, std::size_t n, std::size_t align) noexcept {
+    if (n == 0 || n > MAX_BLOCK_SIZE || align > MAX_BLOCK_ALIGN) {
+        return nullptr;
+    }
+    return (heap != nullptr) ? pool_malloc_aligned_from(heap, n, align) : pool_malloc_aligned(n, align);
+}
+
+/* Description: free ptr to instance if it owns it, nullptr heap = default instance
+ * Args: heap - instance
+ *       ptr - block
+ * Return: true if freed, false if ptr is not from instance
+ */
+inline bool pool_block_free(pool_t* heap, void* ptr) noexcept {
+    if (heap != nullptr ? !pool_owns_from(heap, ptr) : !pool_owns(ptr)) {
+        return false;
+    }
+    if (heap != nullptr) {
+        pool_free_from(heap, ptr);
+    }
+    else {
+        pool_free(ptr);
+    }
+    return true;
+}
+
+/* Description: std::allocator conforming adaptor over a C instance, nullptr heap = default instance
+ *              (requests no pool serves at alignof(T), e.g. bucket arrays, or that find their pool
+ *              exhausted go to operator new, and frees are routed back by address)
+ * Args: T - value type
+ */
+template <class T>
+class pool_allocator {
+public:
+    using value_type = T;
+
+    pool_allocator() noexcept = default;
+    explicit pool_allocator(pool_t* heap) noexcept : heap_(heap) {}
+
+    template <class U>
+    pool_allocator(const pool_allocator<U>& other) noexcept : heap_(other.heap()) {}
+
+    T* allocate(std::size_t n) {
+        if (n > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        void* ptr = pool_block_alloc(heap_, n * sizeof(T), alignof(T));
+        if (ptr == nullptr) {
+            ptr = ::operator new(n * sizeof(T), std::align_val_t(alignof(T)));
+        }
+        return static_cast<T*>(ptr);
+    }
+
+    void deallocate(T* ptr, std::size_t n) noexcept {
+        if (!pool_block_free(heap_, ptr)) {
+            ::operator delete(ptr, n * sizeof(T), std::align_val_t(alignof(T)));
+        }
+    }
+
+    pool_t* heap() const noexcept { return heap_; }
+
+private:
+    pool_t* heap_ = nullptr;
+};
+
+template <class T, class U>
+bool operator==(const pool_allocator<T>& a, const pool_allocator<U>& b) noexcept {
+    return a.heap() == b.heap();
+}
+
+template <class T, class U>
+bool operator!=(const pool_allocator<T>& a, const pool_allocator<U>& b) noexcept {
+    return a.heap() != b.heap();
+}
+
+/* Description: polymorphic memory resource over a C instance, nullptr heap = default instance
+ *              (requests no pool serves, or that find their pool exhausted, go to upstream)
+ */
+class pool_resource : public std::pmr::memory_resource {
+public:
+    explicit pool_resource(pool_t* heap = nullptr,
+                           std::pmr::memory_resource* upstream = std::pmr::new_delete_resource()) noexcept
+        : heap_(heap), upstream_(upstream) {}
+
+    pool_t* heap() const noexcept { return heap_; }
+    std::pmr::memory_resource* upstream_resource() const noexcept { return upstream_; }
+
+protected:
+    void* do_allocate(std::size_t bytes, std::size_t align) override {
+        void* ptr = pool_block_alloc(heap_, bytes, align);
+        return (ptr != nullptr) ? ptr : upstream_->allocate(bytes, align);
+    }
+
+    void do_deallocate(void* ptr, std::size_t bytes, std::size_t align) override {
+        if (!pool_block_free(heap_, ptr)) {
+            upstream_->deallocate(ptr, bytes, align);
+        }
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        const pool_resource* res = dynamic_cast<const pool_resource*>(&other);
+        return res != nullptr && res->heap_ == heap_ && res->upstream_ == upstream_;
+    }
+
+private:
+    pool_t* heap_;
+    std::pmr::memory_resource* upstream_;
+};
+
+/* Description: typed pool of T over a C instance, nullptr heap = default instance
+ *              (objects are constructed in place in blocks of the pool serving sizeof(T) at alignof(T))
+ * Args: T - object type, sizeof(T) <= MAX_BLOCK_SIZE
+ */
+template <class T>
+class object_pool {
+public:
+    static_assert(sizeof(T) <= MAX_BLOCK_SIZE, "T larger than MAX_BLOCK_SIZE");
+
+    object_pool() noexcept = default;
+    explicit object_pool(pool_t* heap) noexcept : heap_(heap) {}
+
+    /* Description: construct a T in a block
+     * Args: args - constructor args
+     * Return: ptr to object, nullptr if no pool serves T or pool exhausted (block returned if constructor throws)
+     */
+    template <class... Args>
+    T* construct(Args&&... args) {
+        void* ptr = pool_block_alloc(heap_, sizeof(T), alignof(T));
+        if (ptr == nullptr) {
+            return nullptr;
+        }
+        try {
+            return ::new (ptr) T(std::forward<Args>(args)...);
+        }
+        catch (...) {
+            pool_block_free(heap_, ptr);
+            throw;
+        }
+    }
+
+    /* Description: destroy object and return its block
+     * Args: obj - object from construct, nullptr ignored
+     * Return: void
+     */
+    void destroy(T* obj) noexcept {
+        if (obj == nullptr) {
+            return;
+        }
+        obj->~T();
+        pool_block_free(heap_, obj);
+    }
+
+    pool_t* heap() const noexcept { return heap_; }
+
+private:
+    pool_t* heap_ = nullptr;
+};
+
+#ifdef POOL_CHECKPOINTS
+/* Description: scope over a C instance, nullptr heap = default instance
+ *              (blocks allocated while the scope is open are returned together when it closes,
+ *              scopes nest and must close innermost first)
+ */
+class pool_scope {
+public:
+    explicit pool_scope(pool_t* heap = nullptr) noexcept
+        : open_(heap != nullptr ? pool_checkpoint_from(heap, &cp_) : pool_checkpoint(&cp_)) {}
+    ~pool_scope() {
+        if (open_) {
+            pool_rollback(&cp_);
+        }
+    }
+
+    pool_scope(const pool_scope&) = delete;
+    pool_scope& operator=(const pool_scope&) = delete;
+
+    /* false if instance does not support checkpoints */
+    explicit operator bool() const noexcept { return open_; }
+
+private:
+    pool_checkpoint_t cp_;
+    bool open_;
+};
+#endif
+
+#endif // __POOL_ALLOC_HPP__